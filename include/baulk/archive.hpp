@@ -4,8 +4,11 @@
 #include <bela/base.hpp>
 #include <bela/time.hpp>
 #include <bela/io.hpp>
+#include <bela/phmap.hpp>
 #include <functional>
 #include <filesystem>
+#include <mutex>
+#include <vector>
 #include "archive/format.hpp"
 
 namespace baulk::archive {
@@ -17,6 +20,7 @@ constexpr long ErrExtractGeneral = 800000;
 constexpr long ErrAnotherWay = 800001;
 constexpr long ErrNoOverlayArchive = 800002;
 namespace fs = std::filesystem;
+class DirectoryCache;
 class File {
 public:
   File(HANDLE fd_) : fd(fd_) {}
@@ -30,12 +34,47 @@ public:
   bool Chtimes(bela::Time t, bela::error_code &ec);
   static std::optional<File> NewFile(const fs::path &path, bela::Time modified, bool overwrite_mode,
                                      bela::error_code &ec);
+  // parent directories are created through dirs, once per extraction
+  static std::optional<File> NewFile(const fs::path &path, bela::Time modified, bool overwrite_mode,
+                                     DirectoryCache &dirs, bela::error_code &ec);
 
 private:
   File() = default;
   HANDLE fd{INVALID_HANDLE_VALUE};
 };
 bool Chtimes(const fs::path &file, bela::Time t, bela::error_code &ec);
+
+// DecoderOptions tunes decoders able to run on several threads (xz), streams written as a single block (plain xz
+// without -T) are still decoded serially
+struct DecoderOptions {
+  // 0: use all processor threads, 1: single threaded decoder
+  uint32_t threads{1};
+  // the threaded decoder falls back to a single thread when it would need more memory than this, 0: 1/4 of RAM
+  uint64_t memlimit{0};
+};
+
+// MappedView maps a whole archive read-only, readers take spans of it instead of copying through buffers
+class MappedView {
+public:
+  MappedView() = default;
+  MappedView(MappedView &&o) noexcept;
+  MappedView &operator=(MappedView &&o) noexcept;
+  MappedView(const MappedView &) = delete;
+  MappedView &operator=(const MappedView &) = delete;
+  ~MappedView();
+  bool Map(HANDLE fd, bela::error_code &ec);
+  explicit operator bool() const { return data != nullptr; }
+  int64_t Size() const { return size; }
+  // Span returns len bytes starting at offset, the caller checks the range against Size()
+  std::span<const uint8_t> Span(int64_t offset, size_t len) const { return {data + offset, len}; }
+
+private:
+  void Free();
+  HANDLE fm{nullptr};
+  const uint8_t *data{nullptr};
+  int64_t size{0};
+};
+
 inline bool MakeDirectories(const fs::path &path, bela::Time modified, bela::error_code &ec) {
   std::error_code e;
   if (fs::create_directories(path, e); e) {
@@ -45,6 +84,25 @@ inline bool MakeDirectories(const fs::path &path, bela::Time modified, bela::err
   return baulk::archive::Chtimes(path, modified, ec);
 }
 
+// DirectoryCache remembers the directories created during one extraction, so each parent is checked or created once
+// instead of once per entry. Directory times are recorded and applied by Finalize after every child was written,
+// writing a child would otherwise reset the parent's modification time. It is safe to share between threads.
+class DirectoryCache {
+public:
+  DirectoryCache() = default;
+  DirectoryCache(const DirectoryCache &) = delete;
+  DirectoryCache &operator=(const DirectoryCache &) = delete;
+  bool MakeDirectories(const fs::path &dir, bela::error_code &ec);
+  // MakeDirectories creates dir and defers setting its time to Finalize
+  bool MakeDirectories(const fs::path &dir, bela::Time modified, bela::error_code &ec);
+  bool Finalize(bela::error_code &ec);
+
+private:
+  std::mutex mtx;
+  bela::flat_hash_set<std::wstring> created;
+  std::vector<std::pair<fs::path, bela::Time>> times;
+};
+
 bool NewSymlink(const fs::path &path, const fs::path &source, bool overwrite_mode, bela::error_code &ec);
 
 std::wstring_view PathStripExtension(std::wstring_view p);
@@ -66,11 +124,26 @@ std::optional<std::wstring> JoinSanitizePath(std::wstring_view root, std::string
                                              bool always_utf8 = true);
 //
 std::wstring EncodeToNativePath(std::string_view filename, bool always_utf8);
+// IsAscii reports names that decode the same in every code page
+constexpr bool IsAscii(std::string_view s) {
+  for (auto c : s) {
+    if (static_cast<unsigned char>(c) >= 0x80) {
+      return false;
+    }
+  }
+  return true;
+}
+// DetectCodePage guesses the code page of legacy names from a sample of them, pure ASCII samples yield CP_UTF8
+uint32_t DetectCodePage(std::string_view sample);
+std::wstring EncodeToNativePath(std::string_view filename, uint32_t codePage);
 bool IsHarmfulPath(std::string_view child_path);
 std::optional<fs::path> JoinSanitizeFsPath(const fs::path &root, std::string_view child_path, bool always_utf8,
                                            std::wstring &encoded_path);
+std::optional<fs::path> JoinSanitizeFsPath(const fs::path &root, std::string_view child_path, uint32_t codePage,
+                                           std::wstring &encoded_path);
 
-//
+// AnalyzeFormat detects the format from the leading bytes of an archive (1024 bytes recognize every format)
+file_format_t AnalyzeFormat(std::span<const uint8_t> magic);
 bool CheckFormat(bela::io::FD &fd, file_format_t &afmt, int64_t &offset, bela::error_code &ec);
 // OpenFile open file and detect archive file format and offset
 inline std::optional<bela::io::FD> OpenFile(std::wstring_view file, int64_t &offset, file_format_t &afmt,
@@ -31,6 +31,11 @@
 /// compute CRC32 using the fastest algorithm for large datasets on modern CPUs
 uint32_t crc32_fast    (const void* data, size_t length, uint32_t previousCrc32 = 0);
 
+/// compute CRC32 with PCLMULQDQ (x86) or the ARMv8 CRC32 instructions, only valid if crc32_hardware_available()
+uint32_t crc32_hardware(const void* data, size_t length, uint32_t previousCrc32 = 0);
+/// true if the CPU supports crc32_hardware, crc32_fast dispatches to it at runtime
+bool     crc32_hardware_available();
+
 /// merge two CRC32 such that result = crc32(dataB, lengthB, crc32(dataA, lengthA))
 uint32_t crc32_combine (uint32_t crcA, uint32_t crcB, size_t lengthB);
 
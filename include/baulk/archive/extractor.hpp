@@ -3,10 +3,14 @@
 #define BAULK_ARCHIVE_EXTRACTOR_HPP
 #include <bela/base.hpp>
 #include <bela/io.hpp>
+#include <bela/ascii.hpp>
 #include <baulk/archive.hpp>
 #include <baulk/archive/zip.hpp>
 #include <baulk/archive/tar.hpp>
 #include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 namespace baulk::archive {
 namespace fs = std::filesystem;
@@ -14,8 +18,23 @@ namespace fs = std::filesystem;
 struct ExtractorOptions {
   bool ignore_error{false};
   bool overwrite_mode{true};
+  // threads used by extraction, 0: use hardware concurrency, 1: serial extraction
+  // zip decompresses entries concurrently, tar pipelines decompression, header parsing and file writes
+  uint32_t threads{1};
+  // read archives through a memory mapping instead of ReadFile
+  bool memory_mapped{false};
+  // threaded decoders (xz), used for zip entries when they are extracted serially and handed to tar::MakeReader by
+  // callers
+  DecoderOptions decoder;
 };
 
+inline uint32_t ResolveThreads(uint32_t threads) {
+  if (threads != 0) {
+    return threads;
+  }
+  return (std::max)(std::thread::hardware_concurrency(), 1u);
+}
+
 namespace zip {
 using Filter = std::function<bool(const File &file, const std::wstring &relative_name)>;
 using OnProgress = std::function<bool(size_t bytes)>;
@@ -37,7 +56,12 @@ public:
       ec = bela::make_error_code_from_std(e, L"fs::canonical() ");
       return false;
     }
-    return reader.OpenReader(zipfile.c_str(), ec);
+    if (!reader.OpenReader(zipfile.c_str(), ec)) {
+      return false;
+    }
+    reader.SetDecoderOptions(entry_decoder());
+    enable_mapping();
+    return true;
   }
   bool OpenReader(bela::io::FD &fd, const fs::path &dest, int64_t size, int64_t offset, bela::error_code &ec) {
     std::error_code e;
@@ -45,14 +69,27 @@ public:
       ec = bela::make_error_code_from_std(e, L"fs::absolute() ");
       return false;
     }
-    return reader.OpenReader(fd.NativeFD(), size, offset, ec);
+    if (!reader.OpenReader(fd.NativeFD(), size, offset, ec)) {
+      return false;
+    }
+    reader.SetDecoderOptions(entry_decoder());
+    enable_mapping();
+    return true;
   }
+  // MappingError reports why memory_mapped was not honored, the archive is then read with positional reads
+  const bela::error_code &MappingError() const { return mappingEc; }
   bool Extract(const Filter &filter, const OnProgress &progress, bela::error_code &ec) {
     std::error_code e;
     if (fs::create_directories(destination, e); e) {
       ec = bela::make_error_code_from_std(e, L"fs::create_directories() ");
       return false;
     }
+    if (auto threads = ResolveThreads(opts.threads); threads > 1) {
+      if (!parallel_extract(threads, filter, progress, ec)) {
+        return false;
+      }
+      return dirs.Finalize(ec);
+    }
     for (const auto &file : reader.Files()) {
       if (!extract_entry(file, filter, progress, ec)) {
         if (ec.code == bela::ErrCanceled || opts.ignore_error == false) {
@@ -60,19 +97,43 @@ public:
         }
       }
     }
-    return true;
+    return dirs.Finalize(ec);
   }
 
 private:
+  struct pending_entry {
+    const File *file{nullptr};
+    fs::path out;
+  };
   ExtractorOptions opts;
   Reader reader;
   fs::path destination;
-  bool create_symlink(const fs::path &_New_symlink, std::string_view linkname, bool always_utf8, bela::error_code &ec) {
+  DirectoryCache dirs;
+  bela::error_code mappingEc;
+  // an archive that cannot be mapped (empty, CreateFileMappingW failed, no address space left in 32-bit builds) is
+  // still readable with ReadFile, the mapping is only an optimization
+  void enable_mapping() {
+    if (opts.memory_mapped && !reader.EnableMapping(mappingEc) && !mappingEc) {
+      mappingEc = bela::make_error_code(bela::ErrGeneral, L"unable to map the archive");
+    }
+  }
+  // entries decoded in parallel already use every worker thread, each entry gets a single threaded decoder instead
+  // of a threaded one (and its own threading memory limit) per worker
+  DecoderOptions entry_decoder() const {
+    auto dopts = opts.decoder;
+    if (ResolveThreads(opts.threads) > 1) {
+      dopts.threads = 1;
+    }
+    return dopts;
+  }
+  uint32_t code_page(const File &file) const { return file.IsFileNameUTF8() ? CP_UTF8 : reader.CodePage(); }
+  bool create_symlink(const fs::path &_New_symlink, std::string_view linkname, uint32_t codePage,
+                      bela::error_code &ec) {
     if (baulk::archive::IsHarmfulPath(linkname)) {
       ec = bela::make_error_code(bela::ErrGeneral, L"harmful path: ", bela::encode_into<char, wchar_t>(linkname));
       return false;
     }
-    std::filesystem::path linkPath(baulk::archive::EncodeToNativePath(linkname, always_utf8));
+    std::filesystem::path linkPath(baulk::archive::EncodeToNativePath(linkname, codePage));
     if (linkPath.is_absolute()) {
       return baulk::archive::NewSymlink(_New_symlink, linkPath, opts.overwrite_mode, ec);
     }
@@ -81,7 +142,7 @@ private:
 
   bool extract_entry(const File &file, const Filter &filter, const OnProgress &progress, bela::error_code &ec) {
     std::wstring encoded_path;
-    auto out = baulk::archive::JoinSanitizeFsPath(destination, file.name, file.IsFileNameUTF8(), encoded_path);
+    auto out = baulk::archive::JoinSanitizeFsPath(destination, file.name, code_page(file), encoded_path);
     if (!out) {
       ec = bela::make_error_code(bela::ErrGeneral, L"harmful path: ", bela::encode_into<char, wchar_t>(file.name));
       return false;
@@ -92,12 +153,16 @@ private:
     }
     std::error_code e;
     if (file.IsDir()) {
-      return MakeDirectories(*out, file.time, ec);
+      return dirs.MakeDirectories(*out, file.time, ec);
     }
     if (file.IsSymlink()) {
-      return create_symlink(*out, reader.ResolveLinkName(file, ec), file.IsFileNameUTF8(), ec);
+      return create_symlink(*out, reader.ResolveLinkName(file, ec), code_page(file), ec);
     }
-    auto fd = baulk::archive::File::NewFile(*out, file.time, opts.overwrite_mode, ec);
+    return decompress_entry(file, *out, progress, ec);
+  }
+
+  bool decompress_entry(const File &file, const fs::path &out, const OnProgress &progress, bela::error_code &ec) {
+    auto fd = baulk::archive::File::NewFile(out, file.time, opts.overwrite_mode, dirs, ec);
     if (!fd) {
       return false;
     }
@@ -113,7 +178,278 @@ private:
         },
         ec);
   }
+
+  // queued maps an output path (ASCII lower-cased, NTFS names are case-insensitive) to its pending entry
+  using queued_entries = bela::flat_hash_map<std::wstring, std::pair<std::vector<pending_entry> *, size_t>>;
+  // prepare_entry runs on the calling thread in archive order: the filter is invoked, directories are created and
+  // regular files and symlinks are queued. An entry replaces an earlier one with the same output path, serial
+  // extraction overwrites it as well so the last entry wins
+  bool prepare_entry(const File &file, const Filter &filter, std::vector<pending_entry> &regulars,
+                     std::vector<pending_entry> &symlinks, queued_entries &queued, bela::error_code &ec) {
+    std::wstring encoded_path;
+    auto out = baulk::archive::JoinSanitizeFsPath(destination, file.name, code_page(file), encoded_path);
+    if (!out) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"harmful path: ", bela::encode_into<char, wchar_t>(file.name));
+      return false;
+    }
+    if (filter && !filter(file, encoded_path)) {
+      ec = bela::make_error_code(bela::ErrCanceled, L"canceled");
+      return false;
+    }
+    if (file.IsDir()) {
+      return dirs.MakeDirectories(*out, file.time, ec);
+    }
+    auto &entries = file.IsSymlink() ? symlinks : regulars;
+    auto [it, inserted] = queued.try_emplace(bela::AsciiStrToLower(out->native()), &entries, entries.size());
+    if (!inserted) {
+      auto &[previous, index] = it->second;
+      (*previous)[index].file = nullptr;
+      it->second = std::make_pair(&entries, entries.size());
+    }
+    entries.emplace_back(pending_entry{.file = &file, .out = std::move(*out)});
+    return true;
+  }
+
+  bool parallel_extract(uint32_t threads, const Filter &filter, const OnProgress &progress, bela::error_code &ec) {
+    std::vector<pending_entry> regulars;
+    std::vector<pending_entry> symlinks;
+    queued_entries queued;
+    for (const auto &file : reader.Files()) {
+      if (!prepare_entry(file, filter, regulars, symlinks, queued, ec)) {
+        if (ec.code == bela::ErrCanceled || opts.ignore_error == false) {
+          return false;
+        }
+      }
+    }
+    threads = static_cast<uint32_t>((std::min)(static_cast<size_t>(threads), regulars.size()));
+    std::mutex mtx; // guards progress callback and first error
+    std::atomic_size_t next{0};
+    std::atomic_bool stopped{false};
+    bela::error_code firstEc;
+    OnProgress lockedProgress;
+    if (progress) {
+      lockedProgress = [&](size_t bytes) -> bool {
+        std::lock_guard<std::mutex> lock(mtx);
+        return progress(bytes);
+      };
+    }
+    auto worker = [&]() {
+      while (!stopped) {
+        auto i = next.fetch_add(1);
+        if (i >= regulars.size()) {
+          return;
+        }
+        if (regulars[i].file == nullptr) {
+          continue; // replaced by a later entry
+        }
+        bela::error_code workerEc;
+        if (decompress_entry(*regulars[i].file, regulars[i].out, lockedProgress, workerEc)) {
+          continue;
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!firstEc) {
+          firstEc = std::move(workerEc);
+        }
+        if (firstEc.code == bela::ErrCanceled || opts.ignore_error == false) {
+          stopped = true;
+        }
+      }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (uint32_t i = 0; i < threads; i++) {
+      workers.emplace_back(worker);
+    }
+    for (auto &w : workers) {
+      w.join();
+    }
+    if (stopped) {
+      ec = std::move(firstEc);
+      return false;
+    }
+    // Symlinks are created last so that no regular file is written through an extracted link
+    for (const auto &s : symlinks) {
+      if (s.file == nullptr) {
+        continue;
+      }
+      if (!create_symlink(s.out, reader.ResolveLinkName(*s.file, ec), code_page(*s.file), ec)) {
+        if (opts.ignore_error == false) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+};
+
+// StreamedEntry records the last entry a StreamExtractor wrote to an output path
+struct StreamedEntry {
+  uint64_t position{0}; // local file header offset
+  FileMode mode{0};
 };
+// StreamedEntries is keyed by output path, ASCII lower-cased
+using StreamedEntries = bela::flat_hash_map<std::wstring, StreamedEntry>;
+
+// StreamExtractor extracts the entries of a zip read front to back (a pipe or a running download). The central
+// directory is not available, so legacy names are decoded with a code page detected per entry, symlinks are written as
+// regular files and entries missing from the central directory are extracted too. Check the result with
+// MatchCentralDirectory once the whole archive is available
+class StreamExtractor {
+public:
+  StreamExtractor(StreamSource *src, const ExtractorOptions &opts_) noexcept
+      : reader(src, opts_.decoder), opts(opts_) {}
+  StreamExtractor(const StreamExtractor &) = delete;
+  StreamExtractor &operator=(const StreamExtractor &) = delete;
+  bool InitializeExtractor(const fs::path &dest, bela::error_code &ec) {
+    std::error_code e;
+    if (destination = fs::absolute(dest, e); e) {
+      ec = bela::make_error_code_from_std(e, L"fs::absolute() ");
+      return false;
+    }
+    return true;
+  }
+  bool Extract(const Filter &filter, const OnProgress &progress, bela::error_code &ec) {
+    std::error_code e;
+    if (fs::create_directories(destination, e); e) {
+      ec = bela::make_error_code_from_std(e, L"fs::create_directories() ");
+      return false;
+    }
+    File file;
+    for (;;) {
+      if (!reader.Next(file, ec)) {
+        if (ec != bela::ErrEnded) {
+          return false;
+        }
+        ec.clear();
+        break;
+      }
+      if (!extract_entry(file, filter, progress, ec)) {
+        if (ec.code == bela::ErrCanceled || opts.ignore_error == false) {
+          return false;
+        }
+      }
+    }
+    return dirs.Finalize(ec);
+  }
+  StreamedEntries &Entries() { return streamed; }
+
+private:
+  StreamReader reader;
+  ExtractorOptions opts;
+  fs::path destination;
+  DirectoryCache dirs;
+  StreamedEntries streamed;
+  static uint32_t code_page(const File &file) {
+    return file.IsFileNameUTF8() ? CP_UTF8 : baulk::archive::DetectCodePage(file.name);
+  }
+  bool create_symlink(const fs::path &_New_symlink, const File &file, bela::error_code &ec) {
+    std::string linkname(file.linkname);
+    if (linkname.empty() && !reader.Decompress(
+                                file,
+                                [&](const void *data, size_t len) {
+                                  linkname.append(static_cast<const char *>(data), len);
+                                  return true;
+                                },
+                                ec)) {
+      return false;
+    }
+    if (baulk::archive::IsHarmfulPath(linkname)) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"harmful path: ", bela::encode_into<char, wchar_t>(linkname));
+      return false;
+    }
+    std::filesystem::path linkPath(baulk::archive::EncodeToNativePath(linkname, code_page(file)));
+    if (linkPath.is_absolute()) {
+      return baulk::archive::NewSymlink(_New_symlink, linkPath, opts.overwrite_mode, ec);
+    }
+    return baulk::archive::NewSymlink(_New_symlink, _New_symlink.parent_path() / linkPath, opts.overwrite_mode, ec);
+  }
+  bool extract_entry(const File &file, const Filter &filter, const OnProgress &progress, bela::error_code &ec) {
+    std::wstring encoded_path;
+    auto out = baulk::archive::JoinSanitizeFsPath(destination, file.name, code_page(file), encoded_path);
+    if (!out) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"harmful path: ", bela::encode_into<char, wchar_t>(file.name));
+      return false;
+    }
+    if (filter && !filter(file, encoded_path)) {
+      ec = bela::make_error_code(bela::ErrCanceled, L"canceled");
+      return false;
+    }
+    streamed.insert_or_assign(bela::AsciiStrToLower(out->native()),
+                              StreamedEntry{.position = file.position, .mode = file.mode});
+    if (file.IsDir()) {
+      return dirs.MakeDirectories(*out, file.time, ec);
+    }
+    if (file.IsSymlink()) {
+      return create_symlink(*out, file, ec);
+    }
+    auto fd = baulk::archive::File::NewFile(*out, file.time, opts.overwrite_mode, dirs, ec);
+    if (!fd) {
+      return false;
+    }
+    bela::error_code writeEc;
+    if (!reader.Decompress(
+            file,
+            [&](const void *data, size_t len) {
+              if (progress && !progress(len)) {
+                // canceled
+                return false;
+              }
+              return fd->WriteFull(data, len, writeEc);
+            },
+            ec)) {
+      fd->Discard();
+      return false;
+    }
+    return true;
+  }
+};
+
+// MatchCentralDirectory checks that a streamed extraction into destination produced the tree Extractor makes from
+// the central directory of archive_file: the same output paths (legacy names decoded with the archive code page),
+// each written by the entry the central directory lists last for it, with the same directory and symlink kinds.
+// A mismatch is reported with ErrGeneral, the caller should extract archive_file again with Extractor
+inline bool MatchCentralDirectory(const fs::path &archive_file, const fs::path &destination,
+                                  const StreamedEntries &streamed, bela::error_code &ec) {
+  std::error_code e;
+  auto root = fs::absolute(destination, e);
+  if (e) {
+    ec = bela::make_error_code_from_std(e, L"fs::absolute() ");
+    return false;
+  }
+  Reader reader;
+  if (!reader.OpenReader(archive_file.native(), ec)) {
+    return false;
+  }
+  bela::flat_hash_map<std::wstring, const File *> listed;
+  for (const auto &file : reader.Files()) {
+    std::wstring encoded_path;
+    auto out = baulk::archive::JoinSanitizeFsPath(
+        root, file.name, file.IsFileNameUTF8() ? CP_UTF8 : reader.CodePage(), encoded_path);
+    if (!out) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"harmful path: ", bela::encode_into<char, wchar_t>(file.name));
+      return false;
+    }
+    listed.insert_or_assign(bela::AsciiStrToLower(out->native()), &file);
+  }
+  if (listed.size() != streamed.size()) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"central directory lists ", listed.size(), L" paths, ",
+                               streamed.size(), L" were streamed");
+    return false;
+  }
+  constexpr auto kinds = FileMode::ModeDir | FileMode::ModeSymlink;
+  for (const auto &[path, file] : listed) {
+    auto it = streamed.find(path);
+    if (it == streamed.end()) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"'", path, L"' was not streamed");
+      return false;
+    }
+    if (it->second.position != file->position || (it->second.mode & kinds) != (file->mode & kinds)) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"'", path, L"' differs from the central directory");
+      return false;
+    }
+  }
+  return true;
+}
 } // namespace zip
 namespace tar {
 using Filter = std::function<bool(const Header &hdr, const std::wstring &relative_name)>;
@@ -142,14 +478,76 @@ public:
       ec = bela::make_error_code_from_std(e, L"fs::create_directories() ");
       return false;
     }
-    auto tr = std::make_shared<baulk::archive::tar::Reader>(reader);
-    std::wstring encoded_path;
+    // a plain tar read from a file has no decoder to overlap, FileReader::WriteTo writes its entries straight from the
+    // file (or the mapping) where the pipeline would copy them twice and hop two threads. A selection stays serial too,
+    // PipeReader would inflate the skipped data instead of letting the reader seek over it
+    if (auto threads = ResolveThreads(opts.threads);
+        threads > 1 && !selector && dynamic_cast<FileReader *>(reader) == nullptr) {
+      // decompression runs in PipeReader, headers are parsed here and files are written by the pool
+      PipeReader pr(reader);
+      WriterPool pool(threads - 1, opts.overwrite_mode, opts.ignore_error, &dirs);
+      auto result = extract_all(&pr, &pool, filter, progress, ec);
+      bela::error_code poolEc;
+      if (!pool.Close(poolEc) && result) {
+        ec = std::move(poolEc);
+        return false;
+      }
+      return result && dirs.Finalize(ec);
+    }
+    return extract_all(reader, nullptr, filter, progress, ec) && dirs.Finalize(ec);
+  }
+  // Select restricts Extract to the entries selector accepts, the data of the other entries is discarded (a gzip reader
+  // with a complete GzipIndex seeks over it)
+  void Select(const Filter &selector_) { selector = selector_; }
+  // RecordToc adds every header Extract reads to toc, toc must outlive the extraction
+  void RecordToc(Toc *toc_) { toc = toc_; }
+  // ExtractToc extracts the entries listed in a Toc instead of parsing headers, reader must be a fresh reader of the
+  // archive (for .tar.gz made with Toc::Index). With a selector only the data of the selected entries is read.
+  bool ExtractToc(const Toc &toc_, const Filter &filter, const OnProgress &progress, bela::error_code &ec) {
+    std::error_code e;
+    if (fs::create_directories(destination, e); e) {
+      ec = bela::make_error_code_from_std(e, L"fs::create_directories() ");
+      return false;
+    }
+    TocReader tr(reader);
+    for (const auto &te : toc_.Entries()) {
+      tr.Seek(te);
+      Header fh{.Name = te.name,
+                .LinkName = te.linkname,
+                .Size = te.size,
+                .Mode = te.mode,
+                .ModTime = te.modified,
+                .Typeflag = te.typeflag};
+      if (extract_entry(tr, fh, nullptr, filter, progress, ec)) {
+        continue;
+      }
+      if (ec == bela::ErrCanceled || ec == ErrExtractGeneral || !opts.ignore_error) {
+        return false;
+      }
+    }
+    ec.clear();
+    return dirs.Finalize(ec);
+  }
+
+private:
+  ExtractReader *reader{nullptr};
+  Filter selector;
+  Toc *toc{nullptr};
+  ExtractorOptions opts;
+  fs::path destination;
+  DirectoryCache dirs;
+  bool extract_all(ExtractReader *r, WriterPool *pool, const Filter &filter, const OnProgress &progress,
+                   bela::error_code &ec) {
+    auto tr = std::make_shared<baulk::archive::tar::Reader>(r);
     for (;;) {
       auto fh = tr->Next(ec);
       if (!fh) {
         break;
       }
-      if (extract_entry(*tr, *fh, filter, progress, ec)) {
+      if (toc != nullptr) {
+        toc->Add(*fh, tr->Position());
+      }
+      if (extract_entry(*tr, *fh, pool, filter, progress, ec)) {
         continue;
       }
       if (ec == bela::ErrCanceled) {
@@ -169,11 +567,6 @@ public:
     ec.clear();
     return true;
   }
-
-private:
-  ExtractReader *reader{nullptr};
-  ExtractorOptions opts;
-  fs::path destination;
   bool create_symlink(const fs::path &_New_symlink, std::string_view linkname, bela::error_code &ec) {
     if (baulk::archive::IsHarmfulPath(linkname)) {
       ec = bela::make_error_code(bela::ErrGeneral, L"harmful path: ", bela::encode_into<char, wchar_t>(linkname));
@@ -185,7 +578,9 @@ private:
     }
     return baulk::archive::NewSymlink(_New_symlink, _New_symlink.parent_path() / linkPath, opts.overwrite_mode, ec);
   }
-  bool extract_entry(Reader &tr, const Header &fh, const Filter &filter, const OnProgress &progress,
+  // Source is the tar Reader or a TocReader positioned at the entry data
+  template <typename Source>
+  bool extract_entry(Source &tr, const Header &fh, WriterPool *pool, const Filter &filter, const OnProgress &progress,
                      bela::error_code &ec) {
     std::wstring encoded_path;
     auto out = baulk::archive::JoinSanitizeFsPath(destination, fh.Name, true, encoded_path);
@@ -193,21 +588,31 @@ private:
       ec = bela::make_error_code(bela::ErrGeneral, L"harmful path: ", bela::encode_into<char, wchar_t>(fh.Name));
       return false;
     }
+    if (selector && !selector(fh, encoded_path)) {
+      return true;
+    }
     if (filter && !filter(fh, encoded_path)) {
       ec = bela::make_error_code(bela::ErrCanceled, L"canceled");
       return false;
     }
     if (fh.IsDir()) {
-      return MakeDirectories(*out, fh.ModTime, ec);
+      return dirs.MakeDirectories(*out, fh.ModTime, ec);
     }
     if (fh.IsSymlink()) {
+      // files queued before the link must not be written through it
+      if (pool != nullptr && !pool->Drain(ec)) {
+        return false;
+      }
       return create_symlink(*out, fh.LinkName, ec);
     }
     // i
     if (!fh.IsRegular()) {
       return true;
     }
-    auto fd = baulk::archive::File::NewFile(*out, fh.ModTime, true, ec);
+    if (pool != nullptr) {
+      return pool_entry(tr, fh, *out, *pool, progress, ec);
+    }
+    auto fd = baulk::archive::File::NewFile(*out, fh.ModTime, opts.overwrite_mode, dirs, ec);
     if (!fd) {
       return false;
     }
@@ -225,6 +630,28 @@ private:
     }
     return true;
   }
+  template <typename Source>
+  bool pool_entry(Source &tr, const Header &fh, const fs::path &out, WriterPool &pool, const OnProgress &progress,
+                  bela::error_code &ec) {
+    if (!pool.Begin(out, fh.ModTime, ec)) {
+      return false;
+    }
+    auto result = tr.WriteTo(
+        [&](const void *data, size_t len, bela::error_code &ec) -> bool {
+          if (progress && !progress(len)) {
+            // canceled
+            return false;
+          }
+          return pool.Write(data, len, ec);
+        },
+        fh.Size, ec);
+    bela::error_code endEc;
+    if (!pool.End(!result, endEc) && result) {
+      ec = std::move(endEc);
+      return false;
+    }
+    return result;
+  }
 };
 } // namespace tar
 } // namespace baulk::archive
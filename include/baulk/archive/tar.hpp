@@ -4,7 +4,16 @@
 #include <bela/io.hpp>
 #include <bela/time.hpp>
 #include <bela/phmap.hpp>
+#include <bela/endian.hpp>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <baulk/archive.hpp>
+#include <baulk/allocate.hpp>
 #include "format.hpp"
 
 namespace baulk::archive::tar {
@@ -275,13 +284,142 @@ public:
   bool WriteTo(const Writer &w, int64_t filesize, int64_t &extracted, bela::error_code &ec);
   bool Seek(int64_t pos, bela::error_code &ec);
   auto Position() const { return position; }
+  // EnableMapping maps the archive into memory, reads no longer issue ReadFile and WriteTo writes from the mapping
+  bool EnableMapping(bela::error_code &ec) { return mv.Map(fd.NativeFD(), ec); }
 
 private:
   bela::io::FD fd;
+  MappedView mv;
   int64_t position{0};
 };
 std::shared_ptr<ExtractReader> MakeReader(FileReader &fd, int64_t offset, file_format_t afmt, bela::error_code &ec);
 
+// GzipIndex holds zran style checkpoints of a gzip stream. Each checkpoint is a deflate block boundary taken about
+// every span uncompressed bytes: its compressed offset, the bits of the previous byte that belong to the block and
+// the 32K inflate window. gzip::Reader records checkpoints while it streams and, once the index covers the stream,
+// Discard resumes inflating from the nearest checkpoint instead of inflating every skipped byte.
+class GzipIndex {
+public:
+  struct Checkpoint {
+    int64_t out{0}; // uncompressed offset
+    int64_t in{0};  // compressed offset relative to the start of the gzip stream
+    int bits{0};
+    std::vector<uint8_t> window;
+  };
+  GzipIndex(int64_t span_ = 4 * 1024 * 1024) : span(span_) {}
+  // archiveSize guards against reusing an index written for another download with the same name
+  bool Load(const std::filesystem::path &file, int64_t archiveSize, bela::error_code &ec);
+  bool Save(const std::filesystem::path &file, int64_t archiveSize, bela::error_code &ec) const;
+  // Encode and Decode let other sidecars (Toc) embed the index
+  void Encode(std::string &data) const;
+  bool Decode(bela::endian::LittenEndian &le, bela::error_code &ec);
+  // Find returns the last checkpoint at or before out
+  const Checkpoint *Find(int64_t out) const {
+    auto it = std::upper_bound(checkpoints.begin(), checkpoints.end(), out,
+                               [](int64_t o, const Checkpoint &cp) { return o < cp.out; });
+    return it == checkpoints.begin() ? nullptr : &*(it - 1);
+  }
+  int64_t Span() const { return span; }
+  // Complete reports whether the stream was scanned to its end, a complete index is no longer recorded
+  bool Complete() const { return complete; }
+  const auto &Checkpoints() const { return checkpoints; }
+  void Add(Checkpoint &&cp) { checkpoints.emplace_back(std::move(cp)); }
+  void MarkComplete() { complete = true; }
+
+private:
+  std::vector<Checkpoint> checkpoints;
+  int64_t span{0};
+  bool complete{false};
+};
+
+// dopts enables the threaded xz decoder
+std::shared_ptr<ExtractReader> MakeReader(FileReader &fd, int64_t offset, file_format_t afmt,
+                                          const DecoderOptions &dopts, bela::error_code &ec);
+// gzip streams record checkpoints into index or seek with them, the index must outlive the reader
+std::shared_ptr<ExtractReader> MakeReader(FileReader &fd, int64_t offset, file_format_t afmt,
+                                          const DecoderOptions &dopts, GzipIndex *index, bela::error_code &ec);
+// MakeReader decodes src as it arrives, src needs neither seeking nor a known size (a download for example)
+std::shared_ptr<ExtractReader> MakeReader(ExtractReader *src, file_format_t afmt, const DecoderOptions &dopts,
+                                          bela::error_code &ec);
+
+// PipeReader runs the underlying reader (usually a decompressor) on its own thread and hands the decompressed data
+// over through a ring of reusable buffers, so the decoder never waits for header parsing or file writes
+class PipeReader : public ExtractReader {
+public:
+  PipeReader(ExtractReader *r_, size_t buffers = 8, size_t bufferSize = 1024 * 1024);
+  PipeReader(const PipeReader &) = delete;
+  PipeReader &operator=(const PipeReader &) = delete;
+  ~PipeReader();
+  ssize_t Read(void *buffer, size_t len, bela::error_code &ec);
+  bool Discard(int64_t len, bela::error_code &ec);
+  bool WriteTo(const Writer &w, int64_t filesize, int64_t &extracted, bela::error_code &ec);
+
+private:
+  void produce();
+  // acquire makes sure the current buffer has unread data, returns 0 when the stream ended and -1 on error
+  ssize_t acquire(bela::error_code &ec);
+  ExtractReader *r{nullptr};
+  std::vector<baulk::mem::Buffer> ring;
+  std::deque<size_t> filled;
+  std::deque<size_t> empties;
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::thread worker;
+  size_t current{SIZE_MAX};
+  ssize_t status{1}; // result of the last underlying Read: 0 ended, -1 failed
+  bela::error_code producerEc;
+  bool closed{false};
+};
+
+// WriterPool materializes regular files on worker threads. Every path is pinned to one worker so that chunks of a file
+// and duplicate entries of the same path are written in archive order.
+// Paths are case-folded before pinning because NTFS treats Foo.txt and foo.txt as the same file
+class WriterPool {
+public:
+  // dirs, when set, is shared with the extractor so parents are created once across the writer threads
+  WriterPool(uint32_t threads, bool overwrite_mode_, bool ignore_error_, DirectoryCache *dirs_ = nullptr,
+             size_t budget_ = 64 * 1024 * 1024);
+  WriterPool(const WriterPool &) = delete;
+  WriterPool &operator=(const WriterPool &) = delete;
+  ~WriterPool();
+  // Begin starts a new file, subsequent Write calls append to it until End
+  bool Begin(const std::filesystem::path &path, bela::Time modified, bela::error_code &ec);
+  bool Write(const void *data, size_t len, bela::error_code &ec);
+  bool End(bool discard, bela::error_code &ec);
+  // Drain waits for every queued task
+  bool Drain(bela::error_code &ec);
+  // Close drains and stops the workers, it returns the first write error
+  bool Close(bela::error_code &ec);
+
+private:
+  enum task_kind : int { task_open, task_write, task_close, task_discard };
+  struct task {
+    task_kind kind{task_write};
+    std::filesystem::path path;
+    bela::Time modified;
+    baulk::mem::Buffer data;
+  };
+  struct queue {
+    std::deque<task> tasks;
+    std::thread worker;
+    bool busy{false};
+  };
+  void run(queue &q);
+  bool push(task &&t, bela::error_code &ec);
+  bool failed(bela::error_code &ec);
+  std::vector<std::unique_ptr<queue>> queues;
+  std::mutex mtx;
+  std::condition_variable cv;
+  size_t budget{0};
+  size_t pending{0}; // bytes queued and not yet written
+  size_t selected{0};
+  bela::error_code firstEc;
+  DirectoryCache *dirs{nullptr};
+  bool overwrite_mode{true};
+  bool ignore_error{false};
+  bool stopped{false};
+};
+
 class Reader {
 public:
   Reader(ExtractReader *r_) : r(r_) {}
@@ -292,6 +430,9 @@ public:
   bool ReadFull(void *buffer, size_t size, bela::error_code &ec);
   bool WriteTo(const Writer &w, int64_t filesize, bela::error_code &ec);
   int Index() const { return index; }
+  // Position returns the offset of the next unread byte in the uncompressed tar stream, right after Next it is the
+  // offset of the entry data
+  int64_t Position() const { return position; }
 
 private:
   bela::ssize_t readInternal(void *buffer, size_t size, bela::error_code &ec);
@@ -305,8 +446,79 @@ private:
   ExtractReader *r{nullptr};
   int64_t remainingSize{0};
   int64_t paddingSize{0};
+  int64_t position{0};
   int index{0};
 };
+
+// TocEntry describes an archive member in a Toc
+struct TocEntry {
+  std::string name;
+  std::string linkname;
+  int64_t offset{0}; // uncompressed offset of the entry data
+  int64_t size{0};
+  int64_t mode{0};
+  bela::Time modified;
+  char typeflag{0};
+};
+
+// Toc is a table of contents sidecar for tar archives: each entry with its uncompressed data offset and, for .tar.gz,
+// the gzip checkpoints needed to resume inflating near it. Listings and selective extraction of a cached archive read
+// the Toc instead of decompressing the whole stream to enumerate headers.
+class Toc {
+public:
+  // key identifies the archive contents, a sidecar written with another key is rejected
+  bool Load(const std::filesystem::path &file, std::string_view key, bela::error_code &ec);
+  // Save is only meaningful after every header of the archive was read
+  bool Save(const std::filesystem::path &file, std::string_view key, bela::error_code &ec) const;
+  void Add(const Header &h, int64_t offset) {
+    entries.emplace_back(TocEntry{.name = h.Name,
+                                  .linkname = h.LinkName,
+                                  .offset = offset,
+                                  .size = h.Size,
+                                  .mode = h.Mode,
+                                  .modified = h.ModTime,
+                                  .typeflag = h.Typeflag});
+  }
+  const auto &Entries() const { return entries; }
+  // Index is attached to the gzip reader while the Toc is built and when entries are read back
+  GzipIndex &Index() { return index; }
+
+private:
+  std::vector<TocEntry> entries;
+  GzipIndex index;
+};
+
+// TocReader reads Toc entries from a fresh reader of the archive (MakeReader with Toc::Index). Entries must be read in
+// archive order, the bytes skipped between them are discarded, which seeks with the gzip checkpoints.
+class TocReader {
+public:
+  TocReader(ExtractReader *r_) : r(r_) {}
+  TocReader(const TocReader &) = delete;
+  TocReader &operator=(const TocReader &) = delete;
+  // Seek moves to the data of e, nothing is read until WriteTo
+  void Seek(const TocEntry &e) { target = e.offset; }
+  // WriteTo has the shape of Reader::WriteTo so the extractor drives both the same way
+  bool WriteTo(const Writer &w, int64_t filesize, bela::error_code &ec) {
+    if (target < position) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"toc entries must be read in archive order");
+      return false;
+    }
+    if (target > position && !r->Discard(target - position, ec)) {
+      return false;
+    }
+    position = target;
+    int64_t extracted{0};
+    auto ret = r->WriteTo(w, filesize, extracted, ec);
+    position += extracted;
+    target = position;
+    return ret;
+  }
+
+private:
+  ExtractReader *r{nullptr};
+  int64_t position{0};
+  int64_t target{0};
+};
 } // namespace baulk::archive::tar
 
 #endif
\ No newline at end of file
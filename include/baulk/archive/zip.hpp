@@ -4,7 +4,11 @@
 #include <bela/base.hpp>
 #include <bela/io.hpp>
 #include <bela/time.hpp>
+#include <baulk/archive.hpp>
 #include <functional>
+#include <memory>
+#include <memory_resource>
+#include <vector>
 
 namespace baulk::archive::zip {
 using bela::os::FileMode;
@@ -58,10 +62,12 @@ struct directoryEnd {
 // FileMode to string
 std::string String(FileMode m);
 
+// File describes a central directory record, its strings point into the arena of the Reader that produced it and
+// remain valid as long as that Reader
 struct File {
-  std::string name;              /* filename */
-  std::string comment;           /* comment */
-  std::string linkname;          /* linkname */
+  std::string_view name;         /* filename */
+  std::string_view comment;      /* comment */
+  std::string_view linkname;     /* linkname */
   uint64_t compressed_size{0};   /* compressed size */
   uint64_t uncompressed_size{0}; /* uncompressed size */
   uint64_t position{0};          /* file position */
@@ -80,25 +86,34 @@ struct File {
   bool IsSymlink() const { return (mode & FileMode::ModeSymlink) != 0; }
   bool StartsWith(std::string_view prefix) const { return name.starts_with(prefix); }
   bool EndsWith(std::string_view suffix) const { return name.ends_with(suffix); }
-  bool Contains(char ch) const { return name.find(ch) != std::string::npos; }
-  bool Contains(std::string_view sv) { return name.find(sv) != std::string::npos; }
+  bool Contains(char ch) const { return name.find(ch) != std::string_view::npos; }
+  bool Contains(std::string_view sv) const { return name.find(sv) != std::string_view::npos; }
 };
 
 constexpr static auto size_max = (std::numeric_limits<std::size_t>::max)();
 
 using Writer = std::function<bool(const void *data, size_t len)>;
+class SectionReader;
+class StreamReader;
 class Reader {
 private:
+  friend class StreamReader;
   void MoveFrom(Reader &&r) {
     fd = std::move(r.fd);
     size = r.size;
     r.size = 0;
+    baseOffset = r.baseOffset;
+    r.baseOffset = 0;
     uncompressed_size = r.uncompressed_size;
     r.uncompressed_size = 0;
     compressed_size = r.compressed_size;
     r.compressed_size = 0;
     comment = std::move(r.comment);
     files = std::move(r.files);
+    arena = std::move(r.arena);
+    mv = std::move(r.mv);
+    dopts = r.dopts;
+    codePage = r.codePage;
   }
 
 public:
@@ -111,14 +126,20 @@ public:
   ~Reader() = default;
   bool OpenReader(std::wstring_view file, bela::error_code &ec);
   bool OpenReader(HANDLE nfd, int64_t size_, int64_t offset_, bela::error_code &ec);
+  // EnableMapping maps the archive into memory, decoders then read the compressed data from the mapping directly
+  bool EnableMapping(bela::error_code &ec) { return mv.Map(fd.NativeFD(), ec); }
+  void SetDecoderOptions(const DecoderOptions &o) { dopts = o; }
   std::string_view Comment() const { return comment; }
   const auto &Files() const { return files; }
   int64_t CompressedSize() const { return compressed_size; }
   int64_t UncompressedSize() const { return uncompressed_size; }
+  // CodePage of the names stored without the UTF-8 flag, detected once over the whole central directory
+  uint32_t CodePage() const { return codePage; }
+  // Decompress only uses positional reads, it is safe to call from several threads at once
   bool Decompress(const File &file, const Writer &w, bela::error_code &ec) const;
   std::string ResolveLinkName(const File &file, bela::error_code &ec) const {
     if (!file.linkname.empty()) {
-      return file.linkname;
+      return std::string(file.linkname);
     }
     std::string linkname;
     if (!Decompress(
@@ -141,20 +162,86 @@ private:
   int64_t compressed_size{0};
   std::string comment;
   std::vector<File> files;
+  // arena owns the central directory bytes the File strings point into, it is heap allocated so moving the Reader
+  // keeps them valid
+  std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+  MappedView mv;
+  DecoderOptions dopts;
+  uint32_t codePage{CP_UTF8};
   bool Initialize(bela::error_code &ec);
+  void detectCodePage();
   bool readDirectoryEnd(directoryEnd &d, bela::error_code &ec);
+  bool readDirectory(const directoryEnd &d, bela::error_code &ec);
   bool readDirectory64End(int64_t offset, directoryEnd &d, bela::error_code &ec);
   int64_t findDirectory64End(int64_t directoryEndOffset, bela::error_code &ec);
-  bool decompressDeflate(const File &file, const Writer &w, bela::error_code &ec) const;
-  bool decompressDeflate64(const File &file, const Writer &w, bela::error_code &ec) const;
-  bool decompressZstd(const File &file, const Writer &w, bela::error_code &ec) const;
-  bool decompressBz2(const File &file, const Writer &w, bela::error_code &ec) const;
-  bool decompressXz(const File &file, const Writer &w, bela::error_code &ec) const;
-  bool decompressLZMA(const File &file, const Writer &w, bela::error_code &ec) const;
-  bool decompressPpmd(const File &file, const Writer &w, bela::error_code &ec) const;
-  bool decompressBrotli(const File &file, const Writer &w, bela::error_code &ec) const;
+  bool decompressSection(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const;
+  bool decompressDeflate(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const;
+  bool decompressDeflate64(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const;
+  bool decompressZstd(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const;
+  bool decompressBz2(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const;
+  bool decompressXz(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const;
+  bool decompressLZMA(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const;
+  bool decompressPpmd(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const;
+  bool decompressBrotli(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const;
 };
 
+// StreamSource is the forward-only input of a StreamReader
+struct StreamSource {
+  // Read returns the number of bytes read, 0 at the end of the input and -1 on error
+  virtual bela::ssize_t Read(void *buffer, size_t len, bela::error_code &ec) = 0;
+};
+
+// HandleSource reads a pipe or a file handle from its current position
+class HandleSource : public StreamSource {
+public:
+  HandleSource(HANDLE fd_) : fd(fd_) {}
+  bela::ssize_t Read(void *buffer, size_t len, bela::error_code &ec);
+
+private:
+  HANDLE fd{INVALID_HANDLE_VALUE};
+};
+
+// StreamReader walks the local file headers of a zip front to back without seeking, so an archive can be extracted
+// from a pipe or while it is still being downloaded. Entries written with a data descriptor (flag bit 3) and no sizes
+// in the local header can only be streamed when they are deflated, inflate finds the end of their data
+class StreamReader {
+public:
+  StreamReader(StreamSource *src_, const DecoderOptions &dopts = {});
+  StreamReader(const StreamReader &) = delete;
+  StreamReader &operator=(const StreamReader &) = delete;
+  // Next reads the next local file header, the data of an entry that was not decompressed is skipped first. Next
+  // fails with ErrEnded once the central directory is reached. The strings of file remain valid until the next call
+  bool Next(File &file, bela::error_code &ec);
+  // Decompress decodes the data of the entry returned by the last Next
+  bool Decompress(const File &file, const Writer &w, bela::error_code &ec);
+  // Position returns the number of bytes consumed from the source
+  int64_t Position() const { return position; }
+
+private:
+  friend class SectionReader;
+  StreamSource *src{nullptr};
+  Reader decoders;
+  std::vector<uint8_t> in;
+  size_t pos{0};
+  size_t size{0};
+  int64_t position{0};
+  std::string header; // name and extra field of the current entry
+  File current;
+  bool pending{false};
+  bool zip64{false};
+  bool fill(bela::error_code &ec);
+  bool readFull(void *buffer, size_t n, bela::error_code &ec);
+  bool discard(uint64_t n, bela::error_code &ec);
+  bool unsized(const File &file) const;
+  bool skip(bela::error_code &ec);
+  bool inflateUnsized(const File &file, const Writer &w, uint32_t &crc, bela::error_code &ec);
+  bool readDescriptor(std::optional<uint32_t> crc, bela::error_code &ec);
+};
+
+// LocateSelfExtracting finds a zip appended to an executable from a single read of the file tail and returns the
+// offset of the archive, -1 when the tail holds no appended zip
+int64_t LocateSelfExtracting(const bela::io::FD &fd, int64_t size, bela::error_code &ec);
+
 // NewReader
 inline std::optional<Reader> NewReader(HANDLE fd, int64_t size, int64_t offset, bela::error_code &ec) {
   Reader r;
@@ -3,6 +3,9 @@
 #define BAULK_HASH_HPP
 #include <bela/base.hpp>
 #include <filesystem>
+#include <memory>
+#include <span>
+#include <vector>
 
 namespace baulk::hash {
 enum class hash_t {
@@ -17,8 +20,39 @@ enum class hash_t {
   SHA3_512, //
   BLAKE3
 };
+// Hasher computes a digest from data arriving in any number of Update calls, e.g. while a file downloads
+class Hasher {
+public:
+  virtual ~Hasher() = default;
+  virtual void Update(const void *data, size_t len) = 0;
+  // UpdateParallel hashes one large buffer, hashers with a tree mode (BLAKE3) spread it over threads
+  virtual void UpdateParallel(const void *data, size_t len, uint32_t threads) = 0;
+  virtual std::wstring Finalize() = 0;
+  // State exposes the running state so that hashing can resume in a later run (a resumed download), the bytes are
+  // only meaningful to the same build
+  virtual std::string_view State() const = 0;
+  // StateVersion tags the layout of State(), Restore rejects a state saved under another version
+  virtual uint16_t StateVersion() const = 0;
+  virtual bool Restore(std::string_view state, uint16_t version) = 0;
+};
+std::unique_ptr<Hasher> NewHasher(hash_t method);
+// ParseHashValue splits 'METHOD:digest' into method and digest, a value without prefix is SHA256
+bool ParseHashValue(std::wstring_view hash_value, hash_t &method, std::wstring_view &value, bela::error_code &ec);
 bool HashEqual(const std::filesystem::path &file, std::wstring_view hash_value, bela::error_code &ec);
-std::optional<std::wstring> FileHash(const std::filesystem::path &file, hash_t method, bela::error_code &ec);
+// FileHashes reads file once and returns one digest per method in the same order, each method runs on its own thread.
+// threads bounds the threads used for file, reader included, 0 allows one per processor. Callers hashing several files
+// at once pass their share so that the threads do not multiply
+std::optional<std::vector<std::wstring>> FileHashes(const std::filesystem::path &file, std::span<const hash_t> methods,
+                                                    uint32_t threads, bela::error_code &ec);
+inline std::optional<std::vector<std::wstring>> FileHashes(const std::filesystem::path &file,
+                                                           std::span<const hash_t> methods, bela::error_code &ec) {
+  return FileHashes(file, methods, 0, ec);
+}
+std::optional<std::wstring> FileHash(const std::filesystem::path &file, hash_t method, uint32_t threads,
+                                     bela::error_code &ec);
+inline std::optional<std::wstring> FileHash(const std::filesystem::path &file, hash_t method, bela::error_code &ec) {
+  return FileHash(file, method, 0, ec);
+}
 struct file_hash_sums {
   std::wstring sha256sum;
   std::wstring blake3sum;
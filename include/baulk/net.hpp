@@ -7,6 +7,9 @@
 
 namespace baulk::net {
 std::wstring_view BestUrl(const std::vector<std::wstring> &urls, std::wstring_view locale);
+// BestUrl reuses the connection time measured for a mirror host during ttl, zero always probes the mirrors. The times
+// are saved in file so that they outlive the process
+void SetMirrorCache(std::wstring_view file, std::chrono::seconds ttl);
 }
 
 #endif
@@ -2,7 +2,10 @@
 #define BAULK_NET_CLIENT_HPP
 #include "types.hpp"
 #include <filesystem>
+#include <functional>
+#include <atomic>
 #include <bela/terminal.hpp>
+#include <baulk/hash.hpp>
 
 namespace baulk::net {
 class Response : private minimal_response {
@@ -27,17 +30,36 @@ private:
   size_t size_{0};
 };
 
+namespace native {
+struct url;
+class handle;
+class session_pool;
+} // namespace native
+namespace net_internal {
+class FilePart;
+struct part_segment;
+} // namespace net_internal
+
 struct download_options {
   std::wstring hash_value;
   std::filesystem::path cwd;
   std::filesystem::path destination;
   bool force_overwrite{false};
+  // connections > 1 splits the download into ranges received concurrently when the server accepts ranges, the
+  // segments are hashed once the file is complete and the sink is not supported
+  uint32_t connections{1};
+  // the body is hashed with these methods while it is written, WinGet returns the digests in the same order
+  std::vector<baulk::hash::hash_t> hash_methods;
+  // sink receives the body as it arrives, it is not called when the download resumes a part file since the leading
+  // bytes were received by an earlier download
+  std::function<void(const void *data, size_t len)> sink;
   bool OverwriteExists() const { return force_overwrite || !destination.empty(); }
 };
 
 class HttpClient {
 public:
-  HttpClient() = default;
+  HttpClient();
+  ~HttpClient();
   HttpClient(const HttpClient &) = delete;
   HttpClient &operator=(const HttpClient &) = delete;
   HttpClient &Set(std::wstring_view key, std::wstring_view value) {
@@ -55,6 +77,9 @@ public:
   }
   std::optional<std::filesystem::path> WinGet(std::wstring_view url, const download_options &opts,
                                               bela::error_code &ec);
+  // WinGet stores the digests of opts.hash_methods into digests
+  std::optional<std::filesystem::path> WinGet(std::wstring_view url, const download_options &opts,
+                                              std::vector<std::wstring> &digests, bela::error_code &ec);
 
   std::wstring_view UserAgent() const { return userAgent; }
   std::wstring_view ProxyURL() const { return proxyURL; }
@@ -101,6 +126,14 @@ public:
   }
 
 private:
+  // segmented_get receives the unfinished segments into part, each on its own connection. first, when set, is the
+  // response to the probing request and serves the first segment
+  bool segmented_get(const native::url &u, native::handle *first, net_internal::FilePart &part,
+                     std::vector<net_internal::part_segment> &segments, std::wstring_view name, bela::error_code &ec);
+  bool get_range(const native::url &u, net_internal::FilePart &part, const net_internal::part_segment &segment,
+                 std::atomic_int64_t &received, const std::atomic_bool &stopped, bela::error_code &ec);
+  // sessions reused by WinRest and WinGet, keeping their connections alive between requests
+  std::unique_ptr<native::session_pool> pool;
   headers_t hkv;
   std::wstring userAgent{L"Wget/7.0 (Baulk)"};
   std::wstring proxyURL;
@@ -123,6 +156,11 @@ inline std::optional<std::filesystem::path> WinGet(std::wstring_view url, const
   return HttpClient::DefaultClient().WinGet(url, opts, ec);
 }
 
+inline std::optional<std::filesystem::path> WinGet(std::wstring_view url, const download_options &opts,
+                                                   std::vector<std::wstring> &digests, bela::error_code &ec) {
+  return HttpClient::DefaultClient().WinGet(url, opts, digests, ec);
+}
+
 } // namespace baulk::net
 
 #endif
\ No newline at end of file
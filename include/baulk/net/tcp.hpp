@@ -3,6 +3,7 @@
 #define BAULK_TCP_HPP
 #include <bela/base.hpp>
 #include <chrono>
+#include <atomic>
 
 namespace baulk::net {
 using BAULKSOCK = UINT_PTR;
@@ -36,6 +37,9 @@ private:
 // timeout milliseconds
 std::optional<Conn> DialTimeout(std::wstring_view address, int port, int timeout,
                                 bela::error_code &ec); // second
+// DialTimeout returns early with ErrCanceled once canceled is set, racing dials stop the losers this way
+std::optional<Conn> DialTimeout(std::wstring_view address, int port, int timeout, const std::atomic_bool &canceled,
+                                bela::error_code &ec);
 } // namespace baulk::net
 
 #endif
\ No newline at end of file
@@ -86,10 +86,15 @@ bool File::WriteFull(const void *data, size_t bytes, bela::error_code &ec) {
   return true;
 }
 
-std::optional<File> File::NewFile(const fs::path &path, bela::Time modified, bool overwrite_mode,
-                                  bela::error_code &ec) {
+inline std::optional<File> new_file(const fs::path &path, bela::Time modified, bool overwrite_mode,
+                                   DirectoryCache *dirs, bela::error_code &ec) {
   std::error_code e;
-  if (fs::exists(path, e)) {
+  if (dirs != nullptr) {
+    // the parent is known to exist after the first entry, CREATE_NEW reports an existing file without a stat
+    if (!dirs->MakeDirectories(path.parent_path(), ec)) {
+      return std::nullopt;
+    }
+  } else if (fs::exists(path, e)) {
     if (!overwrite_mode) {
       ec = bela::make_error_code(ErrGeneral, L"file '", path.native(), L"' exists");
       return std::nullopt;
@@ -101,8 +106,13 @@ std::optional<File> File::NewFile(const fs::path &path, bela::Time modified, boo
     }
   }
   auto fd = CreateFileW(path.c_str(), FILE_GENERIC_READ | FILE_GENERIC_WRITE | GENERIC_READ | GENERIC_WRITE | DELETE,
-                        FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+                        FILE_SHARE_READ, nullptr, overwrite_mode ? CREATE_ALWAYS : CREATE_NEW, FILE_ATTRIBUTE_NORMAL,
+                        nullptr);
   if (fd == INVALID_HANDLE_VALUE) {
+    if (GetLastError() == ERROR_FILE_EXISTS) {
+      ec = bela::make_error_code(ErrGeneral, L"file '", path.native(), L"' exists");
+      return std::nullopt;
+    }
     ec = bela::make_system_error_code(L"CreateFileW ");
     return std::nullopt;
   }
@@ -113,6 +123,70 @@ std::optional<File> File::NewFile(const fs::path &path, bela::Time modified, boo
   return std::make_optional<File>(fd);
 }
 
+std::optional<File> File::NewFile(const fs::path &path, bela::Time modified, bool overwrite_mode,
+                                  bela::error_code &ec) {
+  return new_file(path, modified, overwrite_mode, nullptr, ec);
+}
+
+std::optional<File> File::NewFile(const fs::path &path, bela::Time modified, bool overwrite_mode,
+                                  DirectoryCache &dirs, bela::error_code &ec) {
+  return new_file(path, modified, overwrite_mode, &dirs, ec);
+}
+
+// 'a/b', 'a\b\' and 'a\.\b' name the same directory, they must share one cache key
+inline fs::path directory_key(const fs::path &dir) {
+  auto p = dir.lexically_normal();
+  p.make_preferred();
+  if (!p.has_filename()) {
+    // drop the trailing separator, parent_path() keeps roots such as 'C:\' intact
+    p = p.parent_path();
+  }
+  return p;
+}
+
+bool DirectoryCache::MakeDirectories(const fs::path &dir, bela::error_code &ec) {
+  auto key = directory_key(dir);
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (created.contains(key.native())) {
+      return true;
+    }
+  }
+  std::error_code e;
+  if (fs::create_directories(key, e); e) {
+    ec = bela::make_error_code_from_std(e, L"fs::create_directories() ");
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mtx);
+  // create_directories made every ancestor as well
+  for (auto p = key; !p.empty() && created.emplace(p.native()).second; p = p.parent_path()) {
+    if (p == p.parent_path()) {
+      break;
+    }
+  }
+  return true;
+}
+
+bool DirectoryCache::MakeDirectories(const fs::path &dir, bela::Time modified, bela::error_code &ec) {
+  if (!MakeDirectories(dir, ec)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mtx);
+  times.emplace_back(dir, modified);
+  return true;
+}
+
+bool DirectoryCache::Finalize(bela::error_code &ec) {
+  std::lock_guard<std::mutex> lock(mtx);
+  for (const auto &[dir, modified] : times) {
+    if (!Chtimes(dir, modified, ec)) {
+      return false;
+    }
+  }
+  times.clear();
+  return true;
+}
+
 bool NewSymlink(const fs::path &path, const fs::path &source, bool overwrite_mode, bela::error_code &ec) {
   std::error_code e;
   if (fs::exists(path, e)) {
@@ -146,6 +220,61 @@ bool Chtimes(const fs::path &file, bela::Time t, bela::error_code &ec) {
   return chtimes(fd, t, ec);
 }
 
+MappedView::~MappedView() { Free(); }
+MappedView::MappedView(MappedView &&o) noexcept {
+  fm = o.fm;
+  data = o.data;
+  size = o.size;
+  o.fm = nullptr;
+  o.data = nullptr;
+  o.size = 0;
+}
+MappedView &MappedView::operator=(MappedView &&o) noexcept {
+  Free();
+  fm = o.fm;
+  data = o.data;
+  size = o.size;
+  o.fm = nullptr;
+  o.data = nullptr;
+  o.size = 0;
+  return *this;
+}
+
+void MappedView::Free() {
+  if (data != nullptr) {
+    UnmapViewOfFile(data);
+    data = nullptr;
+  }
+  if (fm != nullptr) {
+    CloseHandle(fm);
+    fm = nullptr;
+  }
+  size = 0;
+}
+
+bool MappedView::Map(HANDLE fd, bela::error_code &ec) {
+  Free();
+  if ((size = bela::io::Size(fd, ec)) == bela::SizeUnInitialized) {
+    size = 0;
+    return false;
+  }
+  if (size == 0) {
+    ec = bela::make_error_code(ErrGeneral, L"unable to map an empty file");
+    return false;
+  }
+  if (fm = CreateFileMappingW(fd, nullptr, PAGE_READONLY, 0, 0, nullptr); fm == nullptr) {
+    ec = bela::make_system_error_code(L"CreateFileMappingW() ");
+    size = 0;
+    return false;
+  }
+  if (data = reinterpret_cast<const uint8_t *>(MapViewOfFile(fm, FILE_MAP_READ, 0, 0, 0)); data == nullptr) {
+    ec = bela::make_system_error_code(L"MapViewOfFile() ");
+    Free();
+    return false;
+  }
+  return true;
+}
+
 constexpr bool is_dot_or_separator(wchar_t ch) { return bela::IsPathSeparator(ch) || ch == L'.'; }
 
 std::wstring_view PathStripExtension(std::wstring_view p) {
@@ -47,7 +47,8 @@ uint32_t codePageSearch(Encoding e) {
       {CZECH_CP852, 852},        //
       {ISO_8859_13, 28603},      // ISO 8859-13 Estonian
       {ISO_2022_KR, 50225},      // ISO 2022 Korean
-      {ISO_2022_CN, 50227}       // ISO 2022 Simplified Chinese; Chinese Simplified (ISO 2022)
+      {ISO_2022_CN, 50227},      // ISO 2022 Simplified Chinese; Chinese Simplified (ISO 2022)
+      {UTF8, CP_UTF8}            // UTF-8 names written without the language encoding flag
   };
   for (const auto c : codePages) {
     if (c.e == e) {
@@ -65,22 +66,59 @@ inline std::wstring encode_from_codepage(std::string_view name, int codePage = C
   return output;
 }
 
-inline std::wstring encode_into_native(std::string_view filename, bool always_utf8) {
-  if (always_utf8) {
-    return bela::encode_into<char, wchar_t>(filename);
+inline std::wstring encode_ascii(std::string_view name) {
+  std::wstring output;
+  output.resize(name.size());
+  for (size_t i = 0; i < name.size(); i++) {
+    output[i] = static_cast<wchar_t>(name[i]);
   }
+  return output;
+}
+
+inline uint32_t detect_code_page(std::string_view sample) {
   bool is_reliable = false;
   int bytes_consumed = 0;
-  auto e = CompactEncDet::DetectEncoding(filename.data(), static_cast<int>(filename.size()), nullptr, nullptr, nullptr,
+  auto e = CompactEncDet::DetectEncoding(sample.data(), static_cast<int>(sample.size()), nullptr, nullptr, nullptr,
                                          UNKNOWN_ENCODING, UNKNOWN_LANGUAGE, CompactEncDet::WEB_CORPUS, false,
                                          &bytes_consumed, &is_reliable);
-  return encode_from_codepage(filename, codePageSearch(e));
+  return codePageSearch(e);
+}
+
+uint32_t DetectCodePage(std::string_view sample) {
+  if (IsAscii(sample)) {
+    return CP_UTF8;
+  }
+  return detect_code_page(sample);
+}
+
+inline std::wstring encode_into_native(std::string_view filename, uint32_t codePage) {
+  if (IsAscii(filename)) {
+    return encode_ascii(filename);
+  }
+  if (codePage == CP_UTF8) {
+    return bela::encode_into<char, wchar_t>(filename);
+  }
+  return encode_from_codepage(filename, codePage);
+}
+
+inline std::wstring encode_into_native(std::string_view filename, bool always_utf8) {
+  if (IsAscii(filename)) {
+    return encode_ascii(filename);
+  }
+  if (always_utf8) {
+    return bela::encode_into<char, wchar_t>(filename);
+  }
+  return encode_from_codepage(filename, detect_code_page(filename));
 }
 
 std::wstring EncodeToNativePath(std::string_view filename, bool always_utf8) {
   return encode_into_native(filename, always_utf8);
 }
 
+std::wstring EncodeToNativePath(std::string_view filename, uint32_t codePage) {
+  return encode_into_native(filename, codePage);
+}
+
 constexpr bool IsDangerousPath(std::wstring_view p) {
   constexpr std::wstring_view dangerousPaths[] = {L":$i30:$bitmap", L"$mft"};
   for (const auto d : dangerousPaths) {
@@ -141,4 +179,13 @@ std::optional<std::filesystem::path> JoinSanitizeFsPath(const std::filesystem::p
   return std::make_optional(root / encoded_path);
 }
 
+std::optional<std::filesystem::path> JoinSanitizeFsPath(const std::filesystem::path &root, std::string_view child_path,
+                                                        uint32_t codePage, std::wstring &encoded_path) {
+  if (is_harmful_path(child_path)) {
+    return std::nullopt;
+  }
+  encoded_path = encode_into_native(child_path, codePage);
+  return std::make_optional(root / encoded_path);
+}
+
 } // namespace baulk::archive
\ No newline at end of file
@@ -18,6 +18,7 @@
 
 
 #include <baulk/archive/details/crc32.h>
+#include <cstring>
 
 #ifndef __LITTLE_ENDIAN
   #define __LITTLE_ENDIAN 1234
@@ -538,6 +539,10 @@ uint32_t crc32_16bytes_prefetch(const void* data, size_t length, uint32_t previo
 /// compute CRC32 using the fastest algorithm for large datasets on modern CPUs
 uint32_t crc32_fast(const void* data, size_t length, uint32_t previousCrc32)
 {
+  // the CPU features are checked once, the tables stay the fallback
+  static const bool hardware = crc32_hardware_available();
+  if (hardware)
+    return crc32_hardware(data, length, previousCrc32);
 #ifdef CRC32_USE_LOOKUP_TABLE_SLICING_BY_16
   return crc32_16bytes (data, length, previousCrc32);
 #elif defined(CRC32_USE_LOOKUP_TABLE_SLICING_BY_8)
@@ -552,6 +557,203 @@ uint32_t crc32_fast(const void* data, size_t length, uint32_t previousCrc32)
 }
 
 
+// //////////////////////////////////////////////////////////
+// hardware CRC32: carry-less multiplication folding on x86 (Intel, "Fast CRC Computation for Generic Polynomials
+// Using PCLMULQDQ Instruction", the same constants as chromium zlib's crc32_sse42_simd_) and the CRC32 instructions
+// on ARMv8
+
+#if defined(_M_AMD64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+  #define CRC32_HARDWARE_PCLMUL
+  #include <emmintrin.h>
+  #include <smmintrin.h>
+  #include <wmmintrin.h>
+  #ifdef _MSC_VER
+    #include <intrin.h>
+  #else
+    #include <cpuid.h>
+  #endif
+  #if defined(__GNUC__) || defined(__clang__)
+    #define CRC32_TARGET_PCLMUL __attribute__((target("sse4.1,pclmul")))
+  #else
+    #define CRC32_TARGET_PCLMUL
+  #endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+  #define CRC32_HARDWARE_ARMV8
+  #ifdef _MSC_VER
+    #include <intrin.h>
+    #include <windows.h>
+  #else
+    #include <arm_acle.h>
+    #include <sys/auxv.h>
+    #include <asm/hwcap.h>
+  #endif
+  #if defined(__GNUC__) || defined(__clang__)
+    #define CRC32_TARGET_ARMV8 __attribute__((target("crc")))
+  #else
+    #define CRC32_TARGET_ARMV8
+  #endif
+#endif
+
+#ifdef CRC32_HARDWARE_PCLMUL
+namespace
+{
+  /// fold 16 byte aligned blocks, length must be at least 64 and a multiple of 16, crc is not inverted
+  CRC32_TARGET_PCLMUL
+  uint32_t crc32_pclmul(const uint8_t* buf, size_t length, uint32_t crc)
+  {
+    alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+    alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+    alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+    alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+    __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x00));
+    __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x10));
+    __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x20));
+    __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+    __m128i x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+    buf    += 64;
+    length -= 64;
+
+    // four 128 bit lanes fold 64 bytes per iteration
+    while (length >= 64)
+    {
+      __m128i x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+      __m128i x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+      __m128i x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+      __m128i x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+      x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+      x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+      x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x00)));
+      x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x10)));
+      x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x20)));
+      x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x30)));
+      buf    += 64;
+      length -= 64;
+    }
+
+    // fold the four lanes into one
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+    __m128i x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), x4), x5);
+
+    // remaining 16 byte blocks
+    while (length >= 16)
+    {
+      x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf))), x5);
+      buf    += 16;
+      length -= 16;
+    }
+
+    // 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, x3), x0, 0x00), x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, x3), x0, 0x10);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, x3), x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+  }
+} // anonymous namespace
+#endif
+
+#ifdef CRC32_HARDWARE_ARMV8
+namespace
+{
+  CRC32_TARGET_ARMV8
+  uint32_t crc32_armv8(const uint8_t* buf, size_t length, uint32_t crc)
+  {
+    while (length != 0 && (reinterpret_cast<uintptr_t>(buf) & 7) != 0)
+    {
+      crc = __crc32b(crc, *buf++);
+      length--;
+    }
+    while (length >= 32)
+    {
+      uint64_t v[4];
+      memcpy(v, buf, sizeof(v));
+      crc = __crc32d(crc, v[0]);
+      crc = __crc32d(crc, v[1]);
+      crc = __crc32d(crc, v[2]);
+      crc = __crc32d(crc, v[3]);
+      buf    += 32;
+      length -= 32;
+    }
+    while (length >= 8)
+    {
+      uint64_t v;
+      memcpy(&v, buf, sizeof(v));
+      crc = __crc32d(crc, v);
+      buf    += 8;
+      length -= 8;
+    }
+    while (length-- != 0)
+      crc = __crc32b(crc, *buf++);
+    return crc;
+  }
+} // anonymous namespace
+#endif
+
+
+/// true if crc32_hardware runs on CPU instructions
+bool crc32_hardware_available()
+{
+#if defined(CRC32_HARDWARE_PCLMUL)
+  unsigned int info[4] = { 0 };
+  #ifdef _MSC_VER
+  __cpuid(reinterpret_cast<int*>(info), 1);
+  #else
+  __get_cpuid(1, &info[0], &info[1], &info[2], &info[3]);
+  #endif
+  // ECX bit 1: PCLMULQDQ, bit 19: SSE4.1
+  return (info[2] & (1u << 1)) != 0 && (info[2] & (1u << 19)) != 0;
+#elif defined(CRC32_HARDWARE_ARMV8)
+  #ifdef _MSC_VER
+  return IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE) != FALSE;
+  #else
+  return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+  #endif
+#else
+  return false;
+#endif
+}
+
+
+/// compute CRC32 with CPU instructions, the caller checks crc32_hardware_available
+uint32_t crc32_hardware(const void* data, size_t length, uint32_t previousCrc32)
+{
+  const uint8_t* buf = static_cast<const uint8_t*>(data);
+#if defined(CRC32_HARDWARE_PCLMUL)
+  if (length >= 64)
+  {
+    size_t chunk = length & ~size_t(15);
+    previousCrc32 = ~crc32_pclmul(buf, chunk, ~previousCrc32);
+    buf    += chunk;
+    length -= chunk;
+  }
+  return crc32_16bytes(buf, length, previousCrc32);
+#elif defined(CRC32_HARDWARE_ARMV8)
+  return ~crc32_armv8(buf, length, ~previousCrc32);
+#else
+  return crc32_16bytes(buf, length, previousCrc32);
+#endif
+}
+
+
 /// merge two CRC32 such that result = crc32(dataB, lengthB, crc32(dataA, lengthA))
 uint32_t crc32_combine(uint32_t crcA, uint32_t crcB, size_t lengthB)
 {
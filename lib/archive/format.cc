@@ -2,6 +2,7 @@
 #include <bela/io.hpp>
 #include <bela/pe.hpp>
 #include <baulk/archive.hpp>
+#include <baulk/archive/zip.hpp>
 #include "tar/tarinternal.hpp"
 
 namespace baulk::archive {
@@ -178,6 +179,10 @@ file_format_t analyze_format_internal(bela::bytes_view bv) {
   return file_format_t::none;
 }
 
+file_format_t AnalyzeFormat(std::span<const uint8_t> magic) {
+  return analyze_format_internal(bela::bytes_view(magic.data(), magic.size()));
+}
+
 constexpr size_t magic_size = 1024;
 
 bool CheckFormat(bela::io::FD &fd, file_format_t &afmt, int64_t &offset, bela::error_code &ec) {
@@ -194,6 +199,17 @@ bool CheckFormat(bela::io::FD &fd, file_format_t &afmt, int64_t &offset, bela::e
   if (!pefile.NewFile(fd.NativeFD(), bela::SizeUnInitialized, ec)) {
     return false;
   }
+  // self-extracting zip: the end record locates the archive, which must be appended to the image (a zip embedded in
+  // the resources is not the payload)
+  if (auto size = fd.Size(ec); size > 0) {
+    if (auto zipOffset = zip::LocateSelfExtracting(fd, size, ec);
+        zipOffset > 0 && zipOffset >= pefile.OverlayOffset()) {
+      afmt = file_format_t::zip;
+      offset = zipOffset;
+      return true;
+    }
+  }
+  ec.clear();
   if (pefile.OverlayLength() < magic_size) {
     // EXE
     return true;
@@ -10,32 +10,54 @@
 namespace baulk::archive::tar {
 
 std::shared_ptr<ExtractReader> MakeReader(FileReader &fd, int64_t offset, file_format_t afmt, bela::error_code &ec) {
+  return MakeReader(fd, offset, afmt, DecoderOptions{}, ec);
+}
+
+std::shared_ptr<ExtractReader> MakeReader(FileReader &fd, int64_t offset, file_format_t afmt,
+                                          const DecoderOptions &dopts, bela::error_code &ec) {
+  return MakeReader(fd, offset, afmt, dopts, nullptr, ec);
+}
+
+std::shared_ptr<ExtractReader> MakeReader(FileReader &fd, int64_t offset, file_format_t afmt,
+                                          const DecoderOptions &dopts, GzipIndex *index, bela::error_code &ec) {
   if (!fd.Seek(offset, ec)) {
     return nullptr;
   }
+  if (afmt == file_format_t::gz && index != nullptr) {
+    if (auto r = std::make_shared<gzip::Reader>(&fd); r->Initialize(ec)) {
+      r->Attach(index, &fd, offset);
+      return r;
+    }
+    return nullptr;
+  }
+  return MakeReader(&fd, afmt, dopts, ec);
+}
+
+std::shared_ptr<ExtractReader> MakeReader(ExtractReader *src, file_format_t afmt, const DecoderOptions &dopts,
+                                          bela::error_code &ec) {
   switch (afmt) {
   case file_format_t::gz:
-    if (auto r = std::make_shared<gzip::Reader>(&fd); r->Initialize(ec)) {
+    if (auto r = std::make_shared<gzip::Reader>(src); r->Initialize(ec)) {
       return r;
     }
     break;
   case file_format_t::bz2:
-    if (auto r = std::make_shared<bzip::Reader>(&fd); r->Initialize(ec)) {
+    if (auto r = std::make_shared<bzip::Reader>(src); r->Initialize(ec)) {
       return r;
     }
     break;
   case file_format_t::zstd:
-    if (auto r = std::make_shared<zstd::Reader>(&fd); r->Initialize(ec)) {
+    if (auto r = std::make_shared<zstd::Reader>(src); r->Initialize(ec)) {
       return r;
     }
     break;
   case file_format_t::xz:
-    if (auto r = std::make_shared<xz::Reader>(&fd); r->Initialize(ec)) {
+    if (auto r = std::make_shared<xz::Reader>(src, dopts); r->Initialize(ec)) {
       return r;
     }
     break;
   case file_format_t::brotli:
-    if (auto r = std::make_shared<brotli::Reader>(&fd); r->Initialize(ec)) {
+    if (auto r = std::make_shared<brotli::Reader>(src); r->Initialize(ec)) {
       return r;
     }
     break;
@@ -1,5 +1,79 @@
 //
 #include "gzip.hpp"
+#include <bela/endian.hpp>
+
+namespace baulk::archive::tar {
+// index file: magic, archive size, then the encoded index: span, complete, count, then out, in, bits, window size and
+// window per checkpoint
+constexpr std::string_view gzipIndexMagic = "BGZIDX01";
+
+void GzipIndex::Encode(std::string &data) const {
+  appendLE(data, span);
+  appendLE(data, static_cast<uint32_t>(complete ? 1 : 0));
+  appendLE(data, static_cast<uint32_t>(checkpoints.size()));
+  for (const auto &cp : checkpoints) {
+    appendLE(data, cp.out);
+    appendLE(data, cp.in);
+    appendLE(data, static_cast<uint32_t>(cp.bits));
+    appendLE(data, static_cast<uint32_t>(cp.window.size()));
+    data.append(reinterpret_cast<const char *>(cp.window.data()), cp.window.size());
+  }
+}
+
+bool GzipIndex::Decode(bela::endian::LittenEndian &le, bela::error_code &ec) {
+  if (le.Size() < 8 + 4 + 4) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"gzip index truncated");
+    return false;
+  }
+  std::vector<Checkpoint> cps;
+  auto span_ = le.Read<int64_t>();
+  auto complete_ = le.Read<uint32_t>() != 0;
+  auto count = le.Read<uint32_t>();
+  for (uint32_t i = 0; i < count; i++) {
+    if (le.Size() < 8 + 8 + 4 + 4) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"gzip index truncated");
+      return false;
+    }
+    Checkpoint cp{.out = le.Read<int64_t>(), .in = le.Read<int64_t>(), .bits = static_cast<int>(le.Read<uint32_t>())};
+    auto wsize = le.Read<uint32_t>();
+    if (wsize > 32768 || le.Size() < wsize || cp.bits > 7 || (!cps.empty() && cp.out <= cps.back().out)) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"gzip index corrupted");
+      return false;
+    }
+    cp.window.assign(le.Data<uint8_t>(), le.Data<uint8_t>() + wsize);
+    le.Discard(wsize);
+    cps.emplace_back(std::move(cp));
+  }
+  checkpoints = std::move(cps);
+  span = span_;
+  complete = complete_;
+  return true;
+}
+
+bool GzipIndex::Load(const std::filesystem::path &file, int64_t archiveSize, bela::error_code &ec) {
+  std::string data;
+  if (!bela::io::ReadFile(file.native(), data, ec, sidecarMaxSize)) {
+    return false;
+  }
+  if (data.size() < gzipIndexMagic.size() + 8 || !data.starts_with(gzipIndexMagic)) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"invalid gzip index");
+    return false;
+  }
+  bela::endian::LittenEndian le(data.data() + gzipIndexMagic.size(), data.size() - gzipIndexMagic.size());
+  if (le.Read<int64_t>() != archiveSize) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"gzip index does not match the archive");
+    return false;
+  }
+  return Decode(le, ec);
+}
+
+bool GzipIndex::Save(const std::filesystem::path &file, int64_t archiveSize, bela::error_code &ec) const {
+  std::string data(gzipIndexMagic);
+  appendLE(data, archiveSize);
+  Encode(data);
+  return bela::io::AtomicWriteText(file.native(), {reinterpret_cast<const uint8_t *>(data.data()), data.size()}, ec);
+}
+} // namespace baulk::archive::tar
 
 namespace baulk::archive::tar::gzip {
 
@@ -25,7 +99,7 @@ bool Reader::Initialize(bela::error_code &ec) {
 
 bool Reader::decompress(bela::error_code &ec) {
   for (;;) {
-    if (zs->avail_out != 0 || pickBytes == 0) {
+    if (zs->avail_in == 0) {
       auto n = r->Read(in.data(), in.capacity(), ec);
       if (n <= 0) {
         return false;
@@ -36,7 +110,8 @@ bool Reader::decompress(bela::error_code &ec) {
     }
     zs->avail_out = static_cast<int>(outsize);
     zs->next_out = out.data();
-    auto ret = ::inflate(zs, Z_NO_FLUSH);
+    // Z_BLOCK stops at every deflate block boundary so the index can record checkpoints
+    auto ret = ::inflate(zs, index != nullptr && !index->Complete() ? Z_BLOCK : Z_NO_FLUSH);
     switch (ret) {
     case Z_NEED_DICT:
       ret = Z_DATA_ERROR;
@@ -50,8 +125,18 @@ bool Reader::decompress(bela::error_code &ec) {
       break;
     }
     auto have = outsize - zs->avail_out;
+    produced += static_cast<int64_t>(have);
     out.pos() = 0;
     out.size() = have;
+    if (ret == Z_STREAM_END) {
+      if (index != nullptr) {
+        index->MarkComplete();
+      }
+      // trailing data after the stream is skipped
+      zs->avail_in = 0;
+    } else if (index != nullptr) {
+      checkpoint();
+    }
     if (have != 0) {
       break;
     }
@@ -59,6 +144,60 @@ bool Reader::decompress(bela::error_code &ec) {
   return true;
 }
 
+void Reader::checkpoint() {
+  // bit 7: at a block boundary, bit 6: the last block
+  if (index->Complete() || (zs->data_type & 128) == 0 || (zs->data_type & 64) != 0) {
+    return;
+  }
+  const auto &checkpoints = index->Checkpoints();
+  if (produced < (checkpoints.empty() ? 0 : checkpoints.back().out) + index->Span()) {
+    return;
+  }
+  GzipIndex::Checkpoint cp{
+      .out = produced, .in = pickBytes - static_cast<int64_t>(zs->avail_in), .bits = zs->data_type & 7};
+  cp.window.resize(32768);
+  uInt len = 0;
+  if (inflateGetDictionary(zs, cp.window.data(), &len) != Z_OK) {
+    return;
+  }
+  cp.window.resize(len);
+  index->Add(std::move(cp));
+}
+
+// restore resumes inflating at a checkpoint: raw deflate from the block boundary, primed with the pending bits and
+// the window. The gzip trailer is no longer verified after a restore.
+bool Reader::restore(const GzipIndex::Checkpoint &cp, bela::error_code &ec) {
+  auto pos = cp.in - (cp.bits != 0 ? 1 : 0);
+  if (!fr->Seek(base + pos, ec)) {
+    return false;
+  }
+  if (auto zerr = inflateReset2(zs, -MAX_WBITS); zerr != Z_OK) {
+    ec = bela::make_error_code(ErrExtractGeneral, bela::encode_into<char, wchar_t>(zError(zerr)));
+    return false;
+  }
+  pickBytes = pos;
+  zs->avail_in = 0;
+  if (cp.bits != 0) {
+    uint8_t ch = 0;
+    if (auto n = r->Read(&ch, 1, ec); n != 1) {
+      if (n == 0) {
+        ec = bela::make_error_code(ErrExtractGeneral, L"gzip index checkpoint beyond end of file");
+      }
+      return false;
+    }
+    pickBytes++;
+    inflatePrime(zs, cp.bits, ch >> (8 - cp.bits));
+  }
+  if (auto zerr = inflateSetDictionary(zs, cp.window.data(), static_cast<uInt>(cp.window.size())); zerr != Z_OK) {
+    ec = bela::make_error_code(ErrExtractGeneral, bela::encode_into<char, wchar_t>(zError(zerr)));
+    return false;
+  }
+  produced = cp.out;
+  out.pos() = 0;
+  out.size() = 0;
+  return true;
+}
+
 // Read data
 ssize_t Reader::Read(void *buffer, size_t len, bela::error_code &ec) {
   if (out.pos() == out.size()) {
@@ -73,6 +212,16 @@ ssize_t Reader::Read(void *buffer, size_t len, bela::error_code &ec) {
 }
 
 bool Reader::Discard(int64_t len, bela::error_code &ec) {
+  if (index != nullptr && len > static_cast<int64_t>(out.size() - out.pos())) {
+    // jump to the last checkpoint before the target when it lies ahead of the inflated data
+    auto target = produced - static_cast<int64_t>(out.size() - out.pos()) + len;
+    if (auto cp = index->Find(target); cp != nullptr && cp->out > produced) {
+      if (!restore(*cp, ec)) {
+        return false;
+      }
+      len = target - cp->out;
+    }
+  }
   while (len > 0) {
     if (out.pos() == out.size()) {
       if (!decompress(ec)) {
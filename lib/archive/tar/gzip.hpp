@@ -15,14 +15,27 @@ public:
   ssize_t Read(void *buffer, size_t len, bela::error_code &ec);
   bool Discard(int64_t len, bela::error_code &ec);
   bool WriteTo(const Writer &w, int64_t filesize,int64_t &extracted,  bela::error_code &ec);
+  // Attach records checkpoints into index and lets Discard seek with them, fr is the reader given to the constructor
+  // and the gzip stream starts at base
+  void Attach(GzipIndex *index_, FileReader *fr_, int64_t base_) {
+    index = index_;
+    fr = fr_;
+    base = base_;
+  }
 
 private:
   bool decompress(bela::error_code &ec);
+  void checkpoint();
+  bool restore(const GzipIndex::Checkpoint &cp, bela::error_code &ec);
   ExtractReader *r{nullptr};
+  FileReader *fr{nullptr};
+  GzipIndex *index{nullptr};
   z_stream *zs{nullptr};
   Buffer out;
   Buffer in;
   int64_t pickBytes{0};
+  int64_t produced{0};
+  int64_t base{0};
 };
 } // namespace baulk::archive::tar::gzip
 
@@ -0,0 +1,279 @@
+//
+#include <bela/ascii.hpp>
+#include "tarinternal.hpp"
+
+namespace baulk::archive::tar {
+
+PipeReader::PipeReader(ExtractReader *r_, size_t buffers, size_t bufferSize) : r(r_) {
+  ring.resize(buffers);
+  for (size_t i = 0; i < ring.size(); i++) {
+    ring[i].grow(bufferSize);
+    empties.push_back(i);
+  }
+  worker = std::thread([this] { produce(); });
+}
+
+PipeReader::~PipeReader() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    closed = true;
+  }
+  cv.notify_all();
+  if (worker.joinable()) {
+    worker.join();
+  }
+}
+
+void PipeReader::produce() {
+  for (;;) {
+    size_t index = 0;
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock, [this] { return closed || !empties.empty(); });
+      if (closed) {
+        return;
+      }
+      index = empties.front();
+      empties.pop_front();
+    }
+    auto &b = ring[index];
+    b.pos() = 0;
+    b.size() = 0;
+    bela::error_code ec;
+    ssize_t n = 1;
+    // fill the whole buffer, the decoders return at most their output window per Read
+    while (b.size() < b.capacity()) {
+      if (n = r->Read(b.data() + b.size(), b.capacity() - b.size(), ec); n <= 0) {
+        break;
+      }
+      b.size() += static_cast<size_t>(n);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (b.size() != 0) {
+        filled.push_back(index);
+      } else {
+        empties.push_back(index);
+      }
+      if (n <= 0) {
+        status = n;
+        producerEc = std::move(ec);
+      }
+    }
+    cv.notify_all();
+    if (n <= 0) {
+      return;
+    }
+  }
+}
+
+ssize_t PipeReader::acquire(bela::error_code &ec) {
+  if (current != SIZE_MAX && ring[current].pos() < ring[current].size()) {
+    return 1;
+  }
+  std::unique_lock<std::mutex> lock(mtx);
+  if (current != SIZE_MAX) {
+    empties.push_back(current);
+    current = SIZE_MAX;
+    cv.notify_all();
+  }
+  cv.wait(lock, [this] { return !filled.empty() || status <= 0; });
+  if (filled.empty()) {
+    ec = producerEc;
+    return status;
+  }
+  current = filled.front();
+  filled.pop_front();
+  return 1;
+}
+
+ssize_t PipeReader::Read(void *buffer, size_t len, bela::error_code &ec) {
+  if (auto n = acquire(ec); n <= 0) {
+    return n;
+  }
+  auto &b = ring[current];
+  auto minsize = (std::min)(len, b.size() - b.pos());
+  memcpy(buffer, b.data() + b.pos(), minsize);
+  b.pos() += minsize;
+  return static_cast<ssize_t>(minsize);
+}
+
+bool PipeReader::Discard(int64_t len, bela::error_code &ec) {
+  while (len > 0) {
+    if (auto n = acquire(ec); n <= 0) {
+      return false;
+    }
+    auto &b = ring[current];
+    auto minsize = (std::min)(static_cast<size_t>(len), b.size() - b.pos());
+    b.pos() += minsize;
+    len -= minsize;
+  }
+  return true;
+}
+
+// Avoid multiple memory copies
+bool PipeReader::WriteTo(const Writer &w, int64_t filesize, int64_t &extracted, bela::error_code &ec) {
+  while (filesize > 0) {
+    if (auto n = acquire(ec); n <= 0) {
+      return false;
+    }
+    auto &b = ring[current];
+    auto minsize = (std::min)(static_cast<size_t>(filesize), b.size() - b.pos());
+    auto p = b.data() + b.pos();
+    b.pos() += minsize;
+    filesize -= minsize;
+    extracted += minsize;
+    if (!w(p, minsize, ec)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+WriterPool::WriterPool(uint32_t threads, bool overwrite_mode_, bool ignore_error_, DirectoryCache *dirs_,
+                       size_t budget_)
+    : budget(budget_), dirs(dirs_), overwrite_mode(overwrite_mode_), ignore_error(ignore_error_) {
+  threads = (std::max)(threads, 1u);
+  for (uint32_t i = 0; i < threads; i++) {
+    queues.emplace_back(std::make_unique<queue>());
+  }
+  for (auto &q : queues) {
+    q->worker = std::thread([this, p = q.get()] { run(*p); });
+  }
+}
+
+WriterPool::~WriterPool() {
+  bela::error_code ec;
+  Close(ec);
+}
+
+void WriterPool::run(queue &q) {
+  std::optional<File> fd;
+  bool broken = false;
+  for (;;) {
+    task t;
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      q.busy = false;
+      cv.notify_all();
+      cv.wait(lock, [&] { return stopped || !q.tasks.empty(); });
+      if (q.tasks.empty()) {
+        return;
+      }
+      t = std::move(q.tasks.front());
+      q.tasks.pop_front();
+      q.busy = true;
+    }
+    bela::error_code ec;
+    switch (t.kind) {
+    case task_open:
+      fd = dirs != nullptr ? File::NewFile(t.path, t.modified, overwrite_mode, *dirs, ec)
+                           : File::NewFile(t.path, t.modified, overwrite_mode, ec);
+      broken = !fd;
+      break;
+    case task_write:
+      if (!broken && !fd->WriteFull(t.data.data(), t.data.size(), ec)) {
+        broken = true;
+      }
+      break;
+    case task_discard:
+      if (fd) {
+        fd->Discard();
+      }
+      fd.reset();
+      break;
+    case task_close:
+      if (fd && broken) {
+        fd->Discard();
+      }
+      fd.reset();
+      break;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    if (t.kind == task_write) {
+      pending -= t.data.size();
+    }
+    if (ec && !firstEc) {
+      firstEc = std::move(ec);
+    }
+  }
+}
+
+bool WriterPool::failed(bela::error_code &ec) {
+  if (firstEc && !ignore_error) {
+    ec = firstEc;
+    return true;
+  }
+  return false;
+}
+
+bool WriterPool::push(task &&t, bela::error_code &ec) {
+  std::unique_lock<std::mutex> lock(mtx);
+  if (t.kind == task_write) {
+    // bound the memory held by queued chunks, a single oversized chunk is always admitted
+    cv.wait(lock, [&] { return pending == 0 || pending + t.data.size() <= budget || (firstEc && !ignore_error); });
+  }
+  if (failed(ec)) {
+    return false;
+  }
+  if (t.kind == task_write) {
+    pending += t.data.size();
+  }
+  queues[selected]->tasks.emplace_back(std::move(t));
+  cv.notify_all();
+  return true;
+}
+
+bool WriterPool::Begin(const std::filesystem::path &path, bela::Time modified, bela::error_code &ec) {
+  // NTFS names are case-insensitive, 'Foo.txt' and 'foo.txt' must land on the same worker
+  selected = std::hash<std::wstring>{}(bela::AsciiStrToLower(path.native())) % queues.size();
+  return push(task{.kind = task_open, .path = path, .modified = modified}, ec);
+}
+
+bool WriterPool::Write(const void *data, size_t len, bela::error_code &ec) {
+  if (len == 0) {
+    return true;
+  }
+  task t{.kind = task_write};
+  t.data.grow(len);
+  memcpy(t.data.data(), data, len);
+  t.data.size() = len;
+  return push(std::move(t), ec);
+}
+
+bool WriterPool::End(bool discard, bela::error_code &ec) {
+  return push(task{.kind = discard ? task_discard : task_close}, ec);
+}
+
+bool WriterPool::Drain(bela::error_code &ec) {
+  std::unique_lock<std::mutex> lock(mtx);
+  cv.wait(lock, [&] {
+    for (const auto &q : queues) {
+      if (q->busy || !q->tasks.empty()) {
+        return false;
+      }
+    }
+    return true;
+  });
+  return !failed(ec);
+}
+
+bool WriterPool::Close(bela::error_code &ec) {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (stopped) {
+      return !failed(ec);
+    }
+    stopped = true;
+  }
+  cv.notify_all();
+  for (auto &q : queues) {
+    if (q->worker.joinable()) {
+      q->worker.join();
+    }
+  }
+  std::lock_guard<std::mutex> lock(mtx);
+  return !failed(ec);
+}
+
+} // namespace baulk::archive::tar
@@ -9,6 +9,10 @@
 namespace baulk::archive::tar {
 
 bool FileReader::Seek(int64_t pos, bela::error_code &ec) {
+  if (mv) {
+    position = pos;
+    return true;
+  }
   if (!fd.Seek(pos, ec)) {
     return false;
   }
@@ -17,6 +21,14 @@ bool FileReader::Seek(int64_t pos, bela::error_code &ec) {
 }
 
 ssize_t FileReader::Read(void *buffer, size_t len, bela::error_code &ec) {
+  if (mv) {
+    auto n = static_cast<size_t>((std::min)(static_cast<int64_t>(len), (std::max)(mv.Size() - position, int64_t{0})));
+    if (n != 0) {
+      memcpy(buffer, mv.Span(position, n).data(), n);
+    }
+    position += static_cast<int64_t>(n);
+    return static_cast<ssize_t>(n);
+  }
   DWORD drSize = {0};
   if (::ReadFile(fd.NativeFD(), buffer, static_cast<DWORD>(len), &drSize, nullptr) != TRUE) {
     ec = bela::make_system_error_code(L"ReadFile: ");
@@ -27,6 +39,10 @@ ssize_t FileReader::Read(void *buffer, size_t len, bela::error_code &ec) {
 }
 
 bool FileReader::Discard(int64_t len, bela::error_code &ec) {
+  if (mv) {
+    position += len;
+    return true;
+  }
   auto li = *reinterpret_cast<LARGE_INTEGER *>(&len);
   LARGE_INTEGER oli{0};
   if (SetFilePointerEx(fd.NativeFD(), li, &oli, SEEK_CUR) != TRUE) {
@@ -38,6 +54,25 @@ bool FileReader::Discard(int64_t len, bela::error_code &ec) {
 }
 
 bool FileReader::WriteTo(const Writer &w, int64_t filesize, int64_t &extracted, bela::error_code &ec) {
+  if (mv) {
+    // write straight from the mapping, 1MB per callback keeps progress responsive
+    constexpr int64_t chunkSize = 1024 * 1024;
+    if (filesize > mv.Size() - position) {
+      ec = bela::make_error_code(bela::ErrEOF, L"Reached the end of the file");
+      return false;
+    }
+    while (filesize > 0) {
+      auto minsize = (std::min)(chunkSize, filesize);
+      auto chunk = mv.Span(position, static_cast<size_t>(minsize));
+      filesize -= minsize;
+      extracted += minsize;
+      position += minsize;
+      if (!w(chunk.data(), chunk.size(), ec)) {
+        return false;
+      }
+    }
+    return true;
+  }
   constexpr int64_t bufferSize = 8192;
   char buffer[bufferSize];
   while (filesize > 0) {
@@ -89,7 +124,11 @@ bela::ssize_t Reader::readInternal(void *buffer, size_t size, bela::error_code &
     ec = bela::make_error_code(ErrNotTarFile, L"underlying reader is null");
     return -1;
   }
-  return r->Read(buffer, size, ec);
+  auto n = r->Read(buffer, size, ec);
+  if (n > 0) {
+    position += n;
+  }
+  return n;
 }
 
 bool Reader::discard(int64_t bytes, bela::error_code &ec) {
@@ -97,7 +136,11 @@ bool Reader::discard(int64_t bytes, bela::error_code &ec) {
     ec = bela::make_error_code(ErrNotTarFile, L"underlying reader is null");
     return false;
   }
-  return r->Discard(bytes, ec);
+  if (!r->Discard(bytes, ec)) {
+    return false;
+  }
+  position += bytes;
+  return true;
 }
 
 bela::ssize_t Reader::Read(void *buffer, size_t size, bela::error_code &ec) {
@@ -453,6 +496,7 @@ bool Reader::WriteTo(const Writer &w, int64_t filesize, bela::error_code &ec) {
   ec.clear();
   int64_t extracted{0};
   auto ret = r->WriteTo(w, filesize, extracted, ec);
+  position += extracted;
   if (remainingSize > 0) {
     remainingSize -= extracted;
   }
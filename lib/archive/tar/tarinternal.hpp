@@ -151,6 +151,15 @@ inline int64_t parseNumeric(const char *p, size_t char_cnt) {
 
 template <size_t N> int64_t parseNumeric(const char (&aArr)[N]) { return parseNumeric(aArr, N); }
 
+// sidecar files (gzip index, toc) are little endian
+constexpr uint64_t sidecarMaxSize = 1024ull * 1024 * 1024;
+template <typename T>
+requires std::integral<T>
+inline void appendLE(std::string &data, T v) {
+  v = bela::fromle(v);
+  data.append(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
 } // namespace baulk::archive::tar
 
 #endif
\ No newline at end of file
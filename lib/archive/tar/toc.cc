@@ -0,0 +1,90 @@
+//
+#include "tarinternal.hpp"
+
+namespace baulk::archive::tar {
+// toc file: magic, key, entry count, entries, then the encoded gzip index
+constexpr std::string_view tocMagic = "BTARTOC1";
+
+inline void appendString(std::string &data, std::string_view sv) {
+  appendLE(data, static_cast<uint32_t>(sv.size()));
+  data.append(sv);
+}
+
+inline bool readString(bela::endian::LittenEndian &le, std::string &s) {
+  if (le.Size() < 4) {
+    return false;
+  }
+  auto len = le.Read<uint32_t>();
+  if (le.Size() < len) {
+    return false;
+  }
+  s.assign(le.Data<char>(), len);
+  le.Discard(len);
+  return true;
+}
+
+bool Toc::Load(const std::filesystem::path &file, std::string_view key, bela::error_code &ec) {
+  std::string data;
+  if (!bela::io::ReadFile(file.native(), data, ec, sidecarMaxSize)) {
+    return false;
+  }
+  if (!data.starts_with(tocMagic)) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"invalid toc");
+    return false;
+  }
+  bela::endian::LittenEndian le(data.data() + tocMagic.size(), data.size() - tocMagic.size());
+  std::string savedKey;
+  if (!readString(le, savedKey) || savedKey != key) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"toc does not match the archive");
+    return false;
+  }
+  if (le.Size() < 4) {
+    ec = bela::make_error_code(ErrExtractGeneral, L"toc truncated");
+    return false;
+  }
+  std::vector<TocEntry> es;
+  auto count = le.Read<uint32_t>();
+  for (uint32_t i = 0; i < count; i++) {
+    TocEntry e;
+    if (!readString(le, e.name) || !readString(le, e.linkname) || le.Size() < 8 * 4 + 1) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"toc truncated");
+      return false;
+    }
+    e.offset = le.Read<int64_t>();
+    e.size = le.Read<int64_t>();
+    e.mode = le.Read<int64_t>();
+    e.modified = bela::FromUnixNanos(le.Read<int64_t>());
+    e.typeflag = static_cast<char>(le.Pick());
+    if (e.offset < 0 || e.size < 0 || (!es.empty() && e.offset < es.back().offset)) {
+      ec = bela::make_error_code(ErrExtractGeneral, L"toc corrupted");
+      return false;
+    }
+    es.emplace_back(std::move(e));
+  }
+  GzipIndex gi;
+  if (!gi.Decode(le, ec)) {
+    return false;
+  }
+  entries = std::move(es);
+  index = std::move(gi);
+  return true;
+}
+
+bool Toc::Save(const std::filesystem::path &file, std::string_view key, bela::error_code &ec) const {
+  std::string data(tocMagic);
+  appendString(data, key);
+  appendLE(data, static_cast<uint32_t>(entries.size()));
+  for (const auto &e : entries) {
+    appendString(data, e.name);
+    appendString(data, e.linkname);
+    appendLE(data, e.offset);
+    appendLE(data, e.size);
+    appendLE(data, e.mode);
+    appendLE(data, bela::ToUnixNanos(e.modified));
+    data.push_back(e.typeflag);
+  }
+  index.Encode(data);
+  return bela::io::AtomicWriteText(file.native(), {reinterpret_cast<const uint8_t *>(data.data()), data.size()}, ec);
+}
+
+} // namespace baulk::archive::tar
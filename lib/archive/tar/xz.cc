@@ -3,6 +3,7 @@
 #define LZMA_API_STATIC 1
 #endif
 #include "xz.hpp"
+#include "../xzdecoder.hpp"
 
 namespace baulk::archive::tar::xz {
 constexpr size_t xzoutsize = 256 * 1024;
@@ -15,14 +16,16 @@ static lzma_allocator allocator{                                  // allocater
                                 .opaque = nullptr};
 Reader::~Reader() {
   if (xzs != nullptr) {
+    lzma_end(xzs);
     baulk::mem::deallocate(xzs);
   }
 }
+
 bool Reader::Initialize(bela::error_code &ec) {
   xzs = baulk::mem::allocate<lzma_stream>();
   memset(xzs, 0, sizeof(lzma_stream));
   xzs->allocator = &allocator;
-  auto ret = lzma_stream_decoder(xzs, UINT64_MAX, LZMA_CONCATENATED);
+  auto ret = InitializeXzDecoder(xzs, dopts);
   if (ret != LZMA_OK) {
     ec = bela::make_error_code(ErrExtractGeneral, L"lzma_stream_decoder error ", ret);
     return false;
@@ -7,7 +7,7 @@
 namespace baulk::archive::tar::xz {
 class Reader : public ExtractReader {
 public:
-  Reader(ExtractReader *lr) : r(lr) {}
+  Reader(ExtractReader *lr, const DecoderOptions &dopts_ = {}) : r(lr), dopts(dopts_) {}
   Reader(const Reader &) = delete;
   Reader &operator=(const Reader &) = delete;
   ~Reader();
@@ -20,6 +20,7 @@ private:
   bool decompress(bela::error_code &ec);
   bela::ssize_t ReadAtLeast(void *buffer, size_t size, bela::error_code &ec);
   ExtractReader *r{nullptr};
+  DecoderOptions dopts;
   lzma_stream *xzs{nullptr};
   Buffer in;
   Buffer out;
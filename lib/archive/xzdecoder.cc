@@ -0,0 +1,21 @@
+///
+#include "xzdecoder.hpp"
+
+namespace baulk::archive {
+// xz -T splits the stream into independent blocks, the threaded decoder decodes them in parallel and decodes
+// single-block streams in its direct (serial) mode
+lzma_ret InitializeXzDecoder(lzma_stream *zs, const DecoderOptions &dopts) {
+  auto threads = dopts.threads == 0 ? lzma_cputhreads() : dopts.threads;
+  if (threads <= 1) {
+    return lzma_stream_decoder(zs, UINT64_MAX, LZMA_CONCATENATED);
+  }
+  lzma_mt mt{
+      .flags = LZMA_CONCATENATED,
+      .threads = threads,
+      .timeout = 0,
+      .memlimit_threading = dopts.memlimit != 0 ? dopts.memlimit : (lzma_physmem() / 4),
+      .memlimit_stop = UINT64_MAX,
+  };
+  return lzma_stream_decoder_mt(zs, &mt);
+}
+} // namespace baulk::archive
@@ -0,0 +1,15 @@
+///
+#ifndef BAULK_ARCHIVE_XZDECODER_HPP
+#define BAULK_ARCHIVE_XZDECODER_HPP
+#ifndef LZMA_API_STATIC
+#define LZMA_API_STATIC 1
+#endif
+#include <baulk/archive.hpp>
+#include <lzma.h>
+
+namespace baulk::archive {
+// InitializeXzDecoder sets up zs for a concatenated xz stream, serial or threaded depending on dopts
+lzma_ret InitializeXzDecoder(lzma_stream *zs, const DecoderOptions &dopts);
+} // namespace baulk::archive
+
+#endif
@@ -6,7 +6,7 @@ namespace baulk::archive::zip {
 
 // https://github.com/google/brotli/blob/master/c/tools/brotli.c#L884
 // Brotli
-bool Reader::decompressBrotli(const File &file, const Writer &w, bela::error_code &ec) const {
+bool Reader::decompressBrotli(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const {
   auto state = BrotliDecoderCreateInstance(baulk::mem::allocate_simple, baulk::mem::deallocate_simple, nullptr);
   if (state == nullptr) {
     ec = bela::make_error_code(L"BrotliDecoderCreateInstance failed");
@@ -22,11 +22,12 @@ bool Reader::decompressBrotli(const File &file, const Writer &w, bela::error_cod
   Summator sum(file.crc32_value);
   while (csize != 0) {
     auto minsize = (std::min)(csize, static_cast<uint64_t>(insize));
-    if (!fd.ReadFull({in.data(), static_cast<size_t>(minsize)}, ec)) {
+    std::span<const uint8_t> chunk;
+    if (!sr.Next(in.data(), static_cast<size_t>(minsize), chunk, ec)) {
       return false;
     }
     auto avail_in = static_cast<size_t>(minsize);
-    const unsigned char *inptr = in.data();
+    const unsigned char *inptr = chunk.data();
     for (;;) {
       auto outptr = out.data();
       auto avail_out = outsize;
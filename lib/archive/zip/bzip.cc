@@ -4,7 +4,7 @@
 
 namespace baulk::archive::zip {
 // bzip2
-bool Reader::decompressBz2(const File &file, const Writer &w, bela::error_code &ec) const {
+bool Reader::decompressBz2(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const {
   bz_stream bzs{nullptr};
   bzs.bzalloc = baulk::mem::allocate_bz;
   bzs.bzfree = baulk::mem::deallocate_simple;
@@ -21,11 +21,12 @@ bool Reader::decompressBz2(const File &file, const Writer &w, bela::error_code &
   Summator sum(file.crc32_value);
   while (csize != 0) {
     auto minsize = (std::min)(csize, static_cast<uint64_t>(insize));
-    if (!fd.ReadFull({in.data(), static_cast<size_t>(minsize)}, ec)) {
+    std::span<const uint8_t> chunk;
+    if (!sr.Next(in.data(), static_cast<size_t>(minsize), chunk, ec)) {
       return false;
     }
     bzs.avail_in = static_cast<unsigned int>(minsize);
-    bzs.next_in = reinterpret_cast<char *>(in.data());
+    bzs.next_in = reinterpret_cast<char *>(const_cast<uint8_t *>(chunk.data()));
     do {
       bzs.avail_out = static_cast<int>(outsize);
       bzs.next_out = reinterpret_cast<char *>(out.data());
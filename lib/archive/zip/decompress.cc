@@ -3,11 +3,40 @@
 #include "zipinternal.hpp"
 
 namespace baulk::archive::zip {
+constexpr size_t storeMappedChunk = 1024 * 1024;
+
+bool ReadFullAt(HANDLE fd, std::span<uint8_t> buffer, int64_t pos, bela::error_code &ec) {
+  auto p = buffer.data();
+  auto size = buffer.size();
+  while (size != 0) {
+    OVERLAPPED o{};
+    o.Offset = static_cast<DWORD>(pos);
+    o.OffsetHigh = static_cast<DWORD>(static_cast<uint64_t>(pos) >> 32);
+    DWORD dwSize = 0;
+    auto want = static_cast<DWORD>((std::min)(size, static_cast<size_t>(UINT32_MAX)));
+    if (::ReadFile(fd, p, want, &dwSize, &o) != TRUE) {
+      if (GetLastError() == ERROR_HANDLE_EOF) {
+        ec = bela::make_error_code(bela::ErrEOF, L"Reached the end of the file");
+        return false;
+      }
+      ec = bela::make_system_error_code(L"ReadFile: ");
+      return false;
+    }
+    if (dwSize == 0) {
+      ec = bela::make_error_code(bela::ErrEOF, L"Reached the end of the file");
+      return false;
+    }
+    p += dwSize;
+    pos += dwSize;
+    size -= dwSize;
+  }
+  return true;
+}
 
 bool Reader::Decompress(const File &file, const Writer &w, bela::error_code &ec) const {
   uint8_t buf[fileHeaderLen];
   auto realPosition = file.position + baseOffset;
-  if (!fd.ReadAt({buf, fileHeaderLen}, realPosition, ec)) {
+  if (!ReadFullAt(fd.NativeFD(), {buf, fileHeaderLen}, realPosition, ec)) {
     return false;
   }
   bela::endian::LittenEndian b(buf, sizeof(buf));
@@ -19,42 +48,45 @@ bool Reader::Decompress(const File &file, const Writer &w, bela::error_code &ec)
   auto filenameLen = static_cast<int>(b.Read<uint16_t>());
   auto extraLen = static_cast<int>(b.Read<uint16_t>());
   auto position = realPosition + fileHeaderLen + filenameLen + extraLen;
-  if (!fd.Seek(position, ec)) {
-    return false;
-  }
+  SectionReader sr(fd.NativeFD(), mv, static_cast<int64_t>(position), file.compressed_size);
+  return decompressSection(file, sr, w, ec);
+}
+
+bool Reader::decompressSection(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const {
   switch (file.method) {
   case ZIP_STORE: {
     uint8_t buffer[4096];
-    auto csize = file.compressed_size;
-    while (csize != 0) {
-      auto minsize = (std::min)(csize, static_cast<uint64_t>(sizeof(buffer)));
-      if (!fd.ReadFull({buffer, static_cast<size_t>(minsize)}, ec)) {
+    // stored data of a mapped archive is written straight from the mapping
+    auto chunkSize = sr.Mapped() ? storeMappedChunk : sizeof(buffer);
+    std::span<const uint8_t> chunk;
+    while (sr.Remaining() != 0) {
+      auto minsize = (std::min)(sr.Remaining(), static_cast<uint64_t>(chunkSize));
+      if (!sr.Next(buffer, static_cast<size_t>(minsize), chunk, ec)) {
         return false;
       }
-      if (!w(buffer, static_cast<size_t>(minsize))) {
+      if (!w(chunk.data(), chunk.size())) {
         return false;
       }
-      csize -= minsize;
     }
   } break;
   case ZIP_DEFLATE:
-    return decompressDeflate(file, w, ec);
+    return decompressDeflate(file, sr, w, ec);
   case ZIP_DEFLATE64:
-    return decompressDeflate64(file, w, ec);
+    return decompressDeflate64(file, sr, w, ec);
   case 20:
     [[fallthrough]];
   case ZIP_ZSTD:
-    return decompressZstd(file, w, ec);
+    return decompressZstd(file, sr, w, ec);
   case ZIP_LZMA:
-    return decompressLZMA(file, w, ec);
+    return decompressLZMA(file, sr, w, ec);
   case ZIP_XZ:
-    return decompressXz(file, w, ec);
+    return decompressXz(file, sr, w, ec);
   case ZIP_BZIP2:
-    return decompressBz2(file, w, ec);
+    return decompressBz2(file, sr, w, ec);
   case ZIP_PPMD:
-    return decompressPpmd(file, w, ec);
+    return decompressPpmd(file, sr, w, ec);
   case ZIP_BROTLI:
-    return decompressBrotli(file, w, ec);
+    return decompressBrotli(file, sr, w, ec);
   default:
     ec = bela::make_error_code(ErrGeneral, L"unsupport zip method ", file.method);
     return false;
@@ -5,7 +5,7 @@
 namespace baulk::archive::zip {
 // DEFLATE
 // https://github.com/madler/zlib/blob/master/examples/zpipe.c#L92
-bool Reader::decompressDeflate(const File &file, const Writer &w, bela::error_code &ec) const {
+bool Reader::decompressDeflate(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const {
   z_stream zs;
   zs.zalloc = baulk::mem::allocate_zlib;
   zs.zfree = baulk::mem::deallocate_simple;
@@ -20,17 +20,21 @@ bool Reader::decompressDeflate(const File &file, const Writer &w, bela::error_co
   int64_t uncsize = 0;
   auto csize = file.compressed_size;
   int ret = Z_OK;
+  // Chromium zlib only fuses the CRC into a copy on the deflate side (copy_with_crc and crc_fold_copy work on a
+  // deflate_state), inflate with a gzip wrapper still checksums its output after each call. The entry CRC is therefore
+  // a Summator pass over each outsize block right after inflate wrote it, while it is still in cache
   Summator sum(file.crc32_value);
   while (csize != 0) {
     auto minsize = (std::min)(csize, static_cast<uint64_t>(insize));
-    if (!fd.ReadFull({in.data(), static_cast<size_t>(minsize)}, ec)) {
+    std::span<const uint8_t> chunk;
+    if (!sr.Next(in.data(), static_cast<size_t>(minsize), chunk, ec)) {
       return false;
     }
     zs.avail_in = static_cast<int>(minsize);
     if (zs.avail_in == 0) {
       break;
     }
-    zs.next_in = in.data();
+    zs.next_in = const_cast<uint8_t *>(chunk.data());
     do {
       zs.avail_out = static_cast<int>(outsize);
       zs.next_out = out.data();
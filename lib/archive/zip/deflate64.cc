@@ -26,42 +26,32 @@ int put(void *out_desc, unsigned char *buf, unsigned len) {
 }
 
 struct inflate64Reader {
-  HANDLE fd{INVALID_HANDLE_VALUE};
+  SectionReader &sr;
   uint8_t *buf{nullptr};
   int64_t count{0};
-  int64_t offset{0};
-  int64_t size{0};
 };
 
 unsigned get(void *in_desc, unsigned char **buf) {
   auto r = reinterpret_cast<inflate64Reader *>(in_desc);
-  auto next = r->buf;
-  if (buf != nullptr) {
-    *buf = next;
-  }
-  auto want = (std::min)(CHUNK, static_cast<DWORD>(r->size - r->offset));
+  auto want = static_cast<DWORD>((std::min)(static_cast<uint64_t>(CHUNK), r->sr.Remaining()));
   if (want == 0) {
     return 0;
   }
-  DWORD got = 0;
-  for (;;) {
-    if (::ReadFile(r->fd, next, want, &got, nullptr) != TRUE) {
-      return 0;
-    }
-    next += got;
-    want -= got;
-    if (got == 0 || want == 0) {
-      break;
-    }
+  bela::error_code ec;
+  std::span<const uint8_t> chunk;
+  if (!r->sr.Next(r->buf, want, chunk, ec)) {
+    return 0;
+  }
+  if (buf != nullptr) {
+    *buf = const_cast<uint8_t *>(chunk.data());
   }
-  auto len = CHUNK - want;
-  r->count += len;
-  r->offset += len;
-  return len;
+  r->count += want;
+  return want;
 }
 
 // DEFLATE64
-bool Reader::decompressDeflate64(const File &file, const Writer &w, bela::error_code &ec) const {
+bool Reader::decompressDeflate64(const File &file, SectionReader &sr, const Writer &w,
+                                 bela::error_code &ec) const {
   Buffer window(65536);
   Buffer chunk(CHUNK);
   z_stream zs;
@@ -81,7 +71,7 @@ bool Reader::decompressDeflate64(const File &file, const Writer &w, bela::error_
       .count = 0,
       .canceled = false //
   };
-  inflate64Reader r{fd.NativeFD(), chunk.data(), 0, 0, static_cast<int64_t>(file.compressed_size)};
+  inflate64Reader r{.sr = sr, .buf = chunk.data(), .count = 0};
   ret = inflateBack9(&zs, get, &r, put, &iw);
   if (iw.canceled) {
     ec = bela::make_error_code(ErrCanceled, L"canceled");
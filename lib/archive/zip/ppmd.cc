@@ -7,91 +7,47 @@
 namespace baulk::archive::zip {
 using bela::ssize_t;
 constexpr auto BufferSize = static_cast<size_t>(1) << 20;
-class SectionReader {
+// ByteReader buffers the section for the byte-at-a-time range decoder
+class ByteReader {
 public:
-  SectionReader(HANDLE fd_, int64_t len) : fd(fd_), size(len) { cacheb.grow(32 * 1024); }
-  SectionReader(const SectionReader &) = delete;
-  SectionReader &operator=(const SectionReader &) = delete;
-  [[nodiscard]] ssize_t Buffered() const { return w - r; }
-  [[nodiscard]] int64_t AvailableBytes() const { return size - offset; }
-  ssize_t Read(void *buffer, ssize_t len) {
-    if (buffer == nullptr || len == 0) {
-      ec = bela::make_error_code(L"buffer is nil");
-      return -1;
+  ByteReader(SectionReader &sr_) : sr(sr_) {
+    if (!sr.Mapped()) {
+      cacheb.grow(32 * 1024);
     }
-    if (r == w) {
-      if (static_cast<size_t>(len) > cacheb.capacity()) {
-        // Large read, empty buffer.
-        // Read directly into p to avoid copy.
-        ssize_t rlen = 0;
-        if (!fsread(buffer, len, rlen, ec)) {
-          return -1;
-        }
-        return rlen;
-      }
-      w = 0;
-      r = 0;
-      // section EOF support
-      DWORD dwRead = static_cast<DWORD>((std::min)(cacheb.capacity(), static_cast<size_t>(size - offset)));
-      if (dwRead == 0) {
-        ec = bela::make_error_code(ERROR_HANDLE_EOF, L"unexpected EOF");
-        return -1;
-      }
-      if (!fsread(cacheb.data(), dwRead, w, ec)) {
-        return -1;
-      }
-      if (w == 0) {
+  }
+  ByteReader(const ByteReader &) = delete;
+  ByteReader &operator=(const ByteReader &) = delete;
+  [[nodiscard]] ssize_t Buffered() const { return static_cast<ssize_t>(window.size() - r); }
+  [[nodiscard]] int64_t AvailableBytes() const { return static_cast<int64_t>(sr.Remaining()); }
+  bool ReadByte(uint8_t &b) {
+    if (r == window.size()) {
+      // section EOF support, a mapped section is handed out whole
+      auto n = sr.Mapped() ? sr.Remaining() : (std::min)(static_cast<uint64_t>(cacheb.capacity()), sr.Remaining());
+      if (n == 0) {
         ec = bela::make_error_code(ERROR_HANDLE_EOF, L"unexpected EOF");
-        return -1;
+        return false;
       }
-    }
-    auto n = (std::min)(w - r, len);
-    memcpy(buffer, cacheb.data() + r, n);
-    r += n;
-    return n;
-  }
-  ssize_t ReadFull(void *buffer, ssize_t len) {
-    auto p = reinterpret_cast<uint8_t *>(buffer);
-    ssize_t n = 0;
-    for (; n < len;) {
-      auto nn = Read(p + n, len - n);
-      if (nn == -1) {
-        return -1;
+      if (!sr.Next(cacheb.data(), static_cast<size_t>(n), window, ec)) {
+        return false;
       }
-      n += nn;
-    }
-    if (n < len) {
-      ec = bela::make_error_code(ERROR_HANDLE_EOF, L"unexpected EOF");
-      return -1;
+      r = 0;
     }
-    return n;
+    b = window[r++];
+    return true;
   }
   const auto &ErrorCode() { return ec; }
 
 private:
-  // reference please don't close it
+  SectionReader &sr;
   Buffer cacheb;
-  HANDLE fd{INVALID_HANDLE_VALUE};
-  int64_t size{0};
-  int64_t offset{0};
-  ssize_t w{0};
-  ssize_t r{0};
+  std::span<const uint8_t> window;
+  size_t r{0};
   bela::error_code ec;
-  bool fsread(void *b, ssize_t len, ssize_t &rlen, bela::error_code &ec) {
-    DWORD dwSize = {0};
-    if (ReadFile(fd, b, static_cast<DWORD>(len), &dwSize, nullptr) != TRUE) {
-      ec = bela::make_system_error_code(L"ReadFile: ");
-      return false;
-    }
-    rlen = static_cast<ssize_t>(len);
-    offset += len;
-    return true;
-  }
 };
 
 struct CByteInToLook {
   IByteIn vt;
-  SectionReader *sr{nullptr};
+  ByteReader *br{nullptr};
 };
 
 Byte ppmd_read(const IByteIn *pp) {
@@ -99,14 +55,14 @@ Byte ppmd_read(const IByteIn *pp) {
     return 0;
   }
   CByteInToLook *p = CONTAINER_FROM_VTBL(pp, CByteInToLook, vt);
-  if (p->sr == nullptr) {
+  if (p->br == nullptr) {
     return 0;
   }
-  Byte buf[8] = {0};
-  if (p->sr->ReadFull(buf, 1) != 1) {
+  uint8_t b = 0;
+  if (!p->br->ReadByte(b)) {
     return 0;
   }
-  return buf[0];
+  return b;
 }
 static void *SzBigAlloc(ISzAllocPtr p, size_t size) {
   (void)p;
@@ -119,18 +75,18 @@ static void SzBigFree(ISzAllocPtr p, void *address) {
 
 const ISzAlloc g_BigAlloc = {SzBigAlloc, SzBigFree};
 
-bool Reader::decompressPpmd(const File &file, const Writer &w, bela::error_code &ec) const {
-  SectionReader sr(fd.NativeFD(), file.compressed_size);
+bool Reader::decompressPpmd(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const {
+  ByteReader br(sr);
   CByteInToLook s;
   s.vt.Read = ppmd_read;
-  s.sr = &sr;
+  s.br = &br;
   CPpmd8 _ppmd = {nullptr};
   _ppmd.Stream.In = reinterpret_cast<IByteIn *>(&s);
   Ppmd8_Construct(&_ppmd);
   auto closer = bela::finally([&] { Ppmd8_Free(&_ppmd, &g_BigAlloc); });
   uint8_t buf[8];
-  if (sr.ReadFull(buf, 2) != 2) {
-    ec = sr.ErrorCode();
+  if (!br.ReadByte(buf[0]) || !br.ReadByte(buf[1])) {
+    ec = br.ErrorCode();
     return false;
   }
   uint32_t val = bela::cast_fromle<uint16_t>(buf);
@@ -172,7 +128,7 @@ bool Reader::decompressPpmd(const File &file, const Writer &w, bela::error_code
       ec = bela::make_error_code(ErrCanceled, L"canceled");
       return false;
     }
-    if (sr.AvailableBytes() == 0 && sr.Buffered() == 0) {
+    if (br.AvailableBytes() == 0 && br.Buffered() == 0) {
       break;
     }
   }
@@ -0,0 +1,303 @@
+///
+#include <bela/endian.hpp>
+#include "zipinternal.hpp"
+#include <zlib.h>
+
+namespace baulk::archive::zip {
+constexpr size_t streamBufferSize = 64 * 1024;
+
+bela::ssize_t HandleSource::Read(void *buffer, size_t len, bela::error_code &ec) {
+  DWORD dwSize = 0;
+  auto want = static_cast<DWORD>((std::min)(len, static_cast<size_t>(UINT32_MAX)));
+  if (::ReadFile(fd, buffer, want, &dwSize, nullptr) != TRUE) {
+    if (auto e = GetLastError(); e == ERROR_BROKEN_PIPE || e == ERROR_HANDLE_EOF) {
+      return 0;
+    }
+    ec = bela::make_system_error_code(L"ReadFile: ");
+    return -1;
+  }
+  return static_cast<bela::ssize_t>(dwSize);
+}
+
+StreamReader::StreamReader(StreamSource *src_, const DecoderOptions &dopts) : src(src_), in(streamBufferSize) {
+  decoders.SetDecoderOptions(dopts);
+}
+
+bool StreamReader::fill(bela::error_code &ec) {
+  if (pos < size) {
+    return true;
+  }
+  auto n = src->Read(in.data(), in.size(), ec);
+  if (n < 0) {
+    return false;
+  }
+  if (n == 0) {
+    ec = bela::make_error_code(bela::ErrEOF, L"zip: unexpected end of stream");
+    return false;
+  }
+  pos = 0;
+  size = static_cast<size_t>(n);
+  return true;
+}
+
+bool StreamReader::readFull(void *buffer, size_t n, bela::error_code &ec) {
+  auto p = reinterpret_cast<uint8_t *>(buffer);
+  while (n != 0) {
+    if (!fill(ec)) {
+      return false;
+    }
+    auto minsize = (std::min)(n, size - pos);
+    memcpy(p, in.data() + pos, minsize);
+    p += minsize;
+    pos += minsize;
+    position += static_cast<int64_t>(minsize);
+    n -= minsize;
+  }
+  return true;
+}
+
+bool StreamReader::discard(uint64_t n, bela::error_code &ec) {
+  while (n != 0) {
+    if (!fill(ec)) {
+      return false;
+    }
+    auto minsize = static_cast<size_t>((std::min)(n, static_cast<uint64_t>(size - pos)));
+    pos += minsize;
+    position += static_cast<int64_t>(minsize);
+    n -= minsize;
+  }
+  return true;
+}
+
+// inflateUnsized decodes an entry whose compressed size is only recorded in the data descriptor. Inflate runs with
+// Z_BLOCK and stops after the end of the final block, the unused input stays buffered for the descriptor
+bool StreamReader::inflateUnsized(const File &file, const Writer &w, uint32_t &crc, bela::error_code &ec) {
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  zs.zalloc = baulk::mem::allocate_zlib;
+  zs.zfree = baulk::mem::deallocate_simple;
+  if (auto zerr = inflateInit2(&zs, -MAX_WBITS); zerr != Z_OK) {
+    ec = bela::make_error_code(ErrGeneral, bela::encode_into<char, wchar_t>(zError(zerr)));
+    return false;
+  }
+  auto closer = bela::finally([&] { inflateEnd(&zs); });
+  Buffer out(outsize);
+  crc = 0;
+  for (;;) {
+    if (!fill(ec)) {
+      return false;
+    }
+    auto avail = size - pos;
+    zs.next_in = in.data() + pos;
+    zs.avail_in = static_cast<uInt>(avail);
+    zs.next_out = out.data();
+    zs.avail_out = static_cast<uInt>(outsize);
+    auto ret = ::inflate(&zs, Z_BLOCK);
+    switch (ret) {
+    case Z_NEED_DICT:
+      ret = Z_DATA_ERROR;
+      [[fallthrough]];
+    case Z_DATA_ERROR:
+      [[fallthrough]];
+    case Z_MEM_ERROR:
+      ec = bela::make_error_code(ret, bela::encode_into<char, wchar_t>(zError(ret)));
+      return false;
+    default:
+      break;
+    }
+    auto consumed = avail - zs.avail_in;
+    pos += consumed;
+    position += static_cast<int64_t>(consumed);
+    if (auto have = outsize - zs.avail_out; have != 0) {
+      crc = crc32_fast(out.data(), have, crc); // CRC32 update
+      if (!w(out.data(), have)) {
+        ec = bela::make_error_code(ErrCanceled, L"canceled");
+        return false;
+      }
+    }
+    // 64: decoding the last block, 128: at a block boundary
+    if ((zs.data_type & 192) == 192) {
+      break;
+    }
+  }
+  if (file.crc32_value != 0 && crc != file.crc32_value) {
+    ec = bela::make_error_code(ErrGeneral, L"crc32 want ", file.crc32_value, L" got ", crc, L" not match");
+    return false;
+  }
+  return true;
+}
+
+// readDescriptor consumes the data descriptor following the entry data, the signature is optional. When crc is set
+// it is checked against the descriptor
+bool StreamReader::readDescriptor(std::optional<uint32_t> crc, bela::error_code &ec) {
+  uint8_t buf[dataDescriptor64Len];
+  if (!readFull(buf, 4, ec)) {
+    return false;
+  }
+  auto want = bela::cast_fromle<uint32_t>(buf);
+  if (want == dataDescriptorSignature) {
+    if (!readFull(buf, 4, ec)) {
+      return false;
+    }
+    want = bela::cast_fromle<uint32_t>(buf);
+  }
+  // compressed and uncompressed sizes, 8 bytes each when the entry has a zip64 extra field
+  if (!readFull(buf, zip64 ? 16 : 8, ec)) {
+    return false;
+  }
+  if (crc && *crc != want) {
+    ec = bela::make_error_code(ErrGeneral, L"crc32 want ", want, L" got ", *crc, L" not match");
+    return false;
+  }
+  return true;
+}
+
+bool StreamReader::unsized(const File &file) const {
+  return (file.flags & 0x8) != 0 && file.compressed_size == 0 && !(file.IsDir() && file.method == ZIP_STORE);
+}
+
+bool StreamReader::Decompress(const File &file, const Writer &w, bela::error_code &ec) {
+  if (!pending) {
+    ec = bela::make_error_code(ErrGeneral, L"zip: the entry data has already been consumed");
+    return false;
+  }
+  pending = false;
+  if (unsized(file)) {
+    if (file.method != ZIP_DEFLATE) {
+      ec = bela::make_error_code(ErrGeneral, L"zip: method ", file.method,
+                                 L" with a data descriptor cannot be decompressed from a stream");
+      return false;
+    }
+    uint32_t crc = 0;
+    return inflateUnsized(file, w, crc, ec) && readDescriptor(crc, ec);
+  }
+  SectionReader sr(this, file.compressed_size);
+  if (!decoders.decompressSection(file, sr, w, ec)) {
+    return false;
+  }
+  // some decoders stop at their end marker before the declared size
+  if (!discard(sr.Remaining(), ec)) {
+    return false;
+  }
+  if ((file.flags & 0x8) != 0) {
+    return readDescriptor(std::nullopt, ec);
+  }
+  return true;
+}
+
+bool StreamReader::skip(bela::error_code &ec) {
+  if (unsized(current)) {
+    return Decompress(current, [](const void *, size_t) { return true; }, ec);
+  }
+  pending = false;
+  if (!discard(current.compressed_size, ec)) {
+    return false;
+  }
+  if ((current.flags & 0x8) != 0) {
+    return readDescriptor(std::nullopt, ec);
+  }
+  return true;
+}
+
+bool StreamReader::Next(File &file, bela::error_code &ec) {
+  if (pending && !skip(ec)) {
+    return false;
+  }
+  auto start = position;
+  uint8_t buf[fileHeaderLen];
+  if (!readFull(buf, 4, ec)) {
+    return false;
+  }
+  auto sig = bela::cast_fromle<uint32_t>(buf);
+  if (start == 0 && sig == dataDescriptorSignature) {
+    // spanned archive marker written before the first local header
+    start = position;
+    if (!readFull(buf, 4, ec)) {
+      return false;
+    }
+    sig = bela::cast_fromle<uint32_t>(buf);
+  }
+  if (sig == static_cast<uint32_t>(directoryHeaderSignature) || sig == static_cast<uint32_t>(directoryEndSignature) ||
+      sig == static_cast<uint32_t>(directory64EndSignature)) {
+    ec = bela::make_error_code(ErrEnded, L"zip: end of the local entries");
+    return false;
+  }
+  if (sig != static_cast<uint32_t>(fileHeaderSignature)) {
+    ec = bela::make_error_code(L"zip: not a valid zip file");
+    return false;
+  }
+  if (!readFull(buf + 4, fileHeaderLen - 4, ec)) {
+    return false;
+  }
+  bela::endian::LittenEndian b(buf + 4, fileHeaderLen - 4);
+  current = File{};
+  current.position = static_cast<uint64_t>(start);
+  current.version_needed = b.Read<uint16_t>();
+  current.flags = b.Read<uint16_t>();
+  current.method = b.Read<uint16_t>();
+  auto dosTime = b.Read<uint16_t>();
+  auto dosDate = b.Read<uint16_t>();
+  current.crc32_value = b.Read<uint32_t>();
+  current.compressed_size = b.Read<uint32_t>();
+  current.uncompressed_size = b.Read<uint32_t>();
+  auto filenameLen = b.Read<uint16_t>();
+  auto extraLen = b.Read<uint16_t>();
+  header.resize(static_cast<size_t>(filenameLen) + extraLen);
+  if (!readFull(header.data(), header.size(), ec)) {
+    return false;
+  }
+  current.name = std::string_view(header.data(), filenameLen);
+  current.time = bela::FromDosDateTime(dosDate, dosTime);
+  zip64 = false;
+  bela::endian::LittenEndian extra(header.data() + filenameLen, extraLen);
+  while (extra.Size() >= 4) {
+    auto fieldTag = extra.Read<uint16_t>();
+    auto fieldSize = static_cast<size_t>(extra.Read<uint16_t>());
+    if (extra.Size() < fieldSize) {
+      break;
+    }
+    bela::endian::LittenEndian fb(extra.Data(), fieldSize);
+    extra.Discard(fieldSize);
+    switch (fieldTag) {
+    case zip64ExtraID:
+      // the local header zip64 field carries the uncompressed size first, then the compressed size
+      zip64 = true;
+      if (current.uncompressed_size == uint32max && fb.Size() >= 8) {
+        current.uncompressed_size = fb.Read<uint64_t>();
+      }
+      if (current.compressed_size == uint32max && fb.Size() >= 8) {
+        current.compressed_size = fb.Read<uint64_t>();
+      }
+      break;
+    case extTimeExtraID:
+      if (fb.Size() >= 5 && (fb.Pick() & 0x1) != 0) {
+        current.time = bela::FromUnixSeconds(static_cast<int64_t>(fb.Read<uint32_t>()));
+      }
+      break;
+    case infoZipUnicodePathID:
+      if (fb.Size() >= 5 && !current.IsFileNameUTF8()) {
+        fb.Discard(5);
+        current.flags |= 0x800;
+        current.name = std::string_view(fb.Data<char>(), fb.Size());
+      }
+      break;
+    case winzipAesExtraID:
+      if (fb.Size() >= 7) {
+        current.aes_version = fb.Read<uint16_t>();
+        fb.Discard(2); // VendorID 'AE'
+        current.aes_strength = fb.Pick();
+        current.method = fb.Read<uint16_t>();
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  // local headers carry no external attributes
+  current.mode = resolveFileMode(current, 0);
+  pending = true;
+  file = current;
+  return true;
+}
+
+} // namespace baulk::archive::zip
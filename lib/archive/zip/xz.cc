@@ -3,7 +3,7 @@
 #define LZMA_API_STATIC 1
 #endif
 #include "zipinternal.hpp"
-#include <lzma.h>
+#include "../xzdecoder.hpp"
 
 namespace baulk::archive::zip {
 constexpr size_t xzoutsize = 256 * 1024;
@@ -13,15 +13,17 @@ static lzma_allocator allocator{                                  // allocater
                                 .alloc = baulk::mem::allocate_xz, //
                                 .free = baulk::mem::deallocate_simple,
                                 .opaque = nullptr};
+
 // XZ
-bool Reader::decompressXz(const File &file, const Writer &w, bela::error_code &ec) const {
+bool Reader::decompressXz(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const {
   lzma_stream zs = LZMA_STREAM_INIT;
   zs.allocator = &allocator;
-  auto ret = lzma_stream_decoder(&zs, UINT64_MAX, LZMA_CONCATENATED);
+  auto ret = InitializeXzDecoder(&zs, dopts);
   if (ret != LZMA_OK) {
     ec = bela::make_error_code(ret, L"lzma_stream_decoder error ", ret);
     return false;
   }
+  auto closer = bela::finally([&] { lzma_end(&zs); });
   Buffer out(xzoutsize);
   Buffer in(xzinsize);
   auto csize = file.compressed_size;
@@ -34,10 +36,11 @@ bool Reader::decompressXz(const File &file, const Writer &w, bela::error_code &e
   for (;;) {
     if (zs.avail_in == 0 && csize != 0) {
       auto minsize = (std::min)(csize, static_cast<uint64_t>(xzinsize));
-      if (!fd.ReadFull({in.data(), static_cast<size_t>(minsize)}, ec)) {
+      std::span<const uint8_t> chunk;
+      if (!sr.Next(in.data(), static_cast<size_t>(minsize), chunk, ec)) {
         return false;
       }
-      zs.next_in = in.data();
+      zs.next_in = chunk.data();
       zs.avail_in = minsize;
       csize -= minsize;
       if (csize == 0) {
@@ -97,7 +100,7 @@ struct alone_header {
 #pragma pack(pop)
 
 // LZMA
-bool Reader::decompressLZMA(const File &file, const Writer &w, bela::error_code &ec) const {
+bool Reader::decompressLZMA(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const {
   lzma_stream zs;
   memset(&zs, 0, sizeof(zs));
   if (auto ret = lzma_alone_decoder(&zs, UINT64_MAX); ret != LZMA_OK) {
@@ -109,7 +112,7 @@ bool Reader::decompressLZMA(const File &file, const Writer &w, bela::error_code
   // $ cat stream_inside_zipx | xxd | head -n 1
   // 00000000: 0914 0500 5d00 8000 0000 2814 .... ....
   uint8_t d[16] = {0};
-  if (!fd.ReadFull({d, 9}, ec)) {
+  if (!sr.ReadFull({d, 9}, ec)) {
     return false;
   }
   if (d[2] != 0x05 || d[3] != 0x00) {
@@ -138,10 +141,11 @@ bool Reader::decompressLZMA(const File &file, const Writer &w, bela::error_code
   for (;;) {
     if (zs.avail_in == 0 && csize > 0) {
       auto minsize = (std::min)(csize, static_cast<uint64_t>(xzinsize));
-      if (!fd.ReadFull({in.data(), static_cast<size_t>(minsize)}, ec)) {
+      std::span<const uint8_t> chunk;
+      if (!sr.Next(in.data(), static_cast<size_t>(minsize), chunk, ec)) {
         return false;
       }
-      zs.next_in = in.data();
+      zs.next_in = chunk.data();
       zs.avail_in = minsize;
       csize -= minsize;
       if (csize == 0) {
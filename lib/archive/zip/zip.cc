@@ -3,22 +3,59 @@
 #include <bela/endian.hpp>
 #include <bela/bufio.hpp>
 #include <bitset>
+#include <algorithm>
+#include <memory_resource>
+#include <bit>
+#if defined(_M_AMD64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+  #define ZIP_SIGNATURE_SSE2
+  #include <emmintrin.h>
+#endif
 #include <bela/terminal.hpp>
 #include "zipinternal.hpp"
 
 namespace baulk::archive::zip {
 
-int findSignatureInBlock(const bela::Buffer &b) {
-  for (auto i = static_cast<int>(b.size()) - directoryEndLen; i >= 0; i--) {
-    if (b[i] == 'P' && b[i + 1] == 'K' && b[i + 2] == 0x05 && b[i + 3] == 0x06) {
-      auto n = static_cast<int>(b[i + directoryEndLen - 2]) | (static_cast<int>(b[i + directoryEndLen - 1]) << 8);
-      if (n + directoryEndLen + i <= static_cast<int>(b.size())) {
-        return i;
+inline bool isDirectoryEnd(const uint8_t *b, size_t size, size_t i) {
+  auto n = static_cast<size_t>(b[i + directoryEndLen - 2]) | (static_cast<size_t>(b[i + directoryEndLen - 1]) << 8);
+  return n + directoryEndLen + i <= size;
+}
+
+// findSignatureInBlock returns the offset of the last end of central directory record in b, -1 when there is none.
+// With SSE2 sixteen candidate offsets are compared against PK\x05\x06 at once, walking backwards
+int findSignatureInBlock(const uint8_t *b, size_t size) {
+  if (size < directoryEndLen) {
+    return -1;
+  }
+  auto i = static_cast<int64_t>(size - directoryEndLen);
+#ifdef ZIP_SIGNATURE_SSE2
+  const auto sigP = _mm_set1_epi8('P');
+  const auto sigK = _mm_set1_epi8('K');
+  const auto sig5 = _mm_set1_epi8(0x05);
+  const auto sig6 = _mm_set1_epi8(0x06);
+  auto load = [](const uint8_t *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); };
+  for (; i >= 15; i -= 16) {
+    // candidates i-15 .. i, the last load ends at i+3 which is inside the block
+    auto s = b + i - 15;
+    auto m = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(load(s), sigP), _mm_cmpeq_epi8(load(s + 1), sigK)),
+                           _mm_and_si128(_mm_cmpeq_epi8(load(s + 2), sig5), _mm_cmpeq_epi8(load(s + 3), sig6)));
+    for (auto mask = static_cast<uint32_t>(_mm_movemask_epi8(m)); mask != 0;) {
+      auto bit = 31 - std::countl_zero(mask);
+      if (auto pos = static_cast<size_t>(i - 15 + bit); isDirectoryEnd(b, size, pos)) {
+        return static_cast<int>(pos);
       }
+      mask &= ~(1u << bit);
+    }
+  }
+#endif
+  for (; i >= 0; i--) {
+    if (b[i] == 'P' && b[i + 1] == 'K' && b[i + 2] == 0x05 && b[i + 3] == 0x06 &&
+        isDirectoryEnd(b, size, static_cast<size_t>(i))) {
+      return static_cast<int>(i);
     }
   }
   return -1;
 }
+
 bool Reader::readDirectory64End(int64_t offset, directoryEnd &d, bela::error_code &ec) {
   uint8_t buffer[256];
   if (!fd.ReadAt({buffer, directory64EndLen}, offset, ec)) {
@@ -66,30 +103,20 @@ int64_t Reader::findDirectory64End(int64_t directoryEndOffset, bela::error_code
 
 // github.com\klauspost\compress@v1.11.3\zip\reader.go
 bool Reader::readDirectoryEnd(directoryEnd &d, bela::error_code &ec) {
-  bela::Buffer buffer(16 * 1024);
-  int64_t directoryEndOffset = 0;
-  constexpr int64_t offrange[] = {1024, 65 * 1024};
-  bela::endian::LittenEndian b;
-  for (size_t i = 0; i < std::size(offrange); i++) {
-    auto blen = offrange[i];
-    if (blen > size) {
-      blen = size;
-    }
-    buffer.grow(blen);
-    if (!fd.ReadAt(buffer, blen, size - blen, ec)) {
-      return false;
-    }
-    buffer.size() = blen;
-    if (auto p = findSignatureInBlock(buffer); p >= 0) {
-      b.Reset({buffer.data() + p, static_cast<size_t>(blen - p)});
-      directoryEndOffset = size - blen + p;
-      break;
-    }
-    if (i == 1 || blen == size) {
-      ec = bela::make_error_code(L"zip: not a valid zip file");
-      return false;
-    }
+  // a single read covers the record and the longest comment it may carry
+  auto blen = (std::min)(size, directoryEndSearchLen);
+  bela::Buffer buffer(static_cast<size_t>(blen));
+  if (!fd.ReadAt(buffer, static_cast<size_t>(blen), size - blen, ec)) {
+    return false;
+  }
+  buffer.size() = static_cast<size_t>(blen);
+  auto p = findSignatureInBlock(buffer.data(), buffer.size());
+  if (p < 0) {
+    ec = bela::make_error_code(L"zip: not a valid zip file");
+    return false;
   }
+  bela::endian::LittenEndian b(buffer.data() + p, static_cast<size_t>(blen - p));
+  auto directoryEndOffset = size - blen + p;
   if (b.Discard(4) < 18) {
     ec = bela::make_error_code(L"zip: not a valid zip file");
     return false;
@@ -155,12 +182,12 @@ constexpr uint64_t OffsetMin = 0xFFFFFFFFull;
 
 */
 
-bool readDirectoryHeader(bufioReader &br, Buffer &buffer, File &file, bela::error_code &ec) {
-  uint8_t buf[directoryHeaderLen];
-  if (br.ReadFull(buf, sizeof(buf), ec) != sizeof(buf)) {
+// parseDirectoryHeader parses the record at the start of b in place, b is advanced to the next record
+bool parseDirectoryHeader(bela::endian::LittenEndian &b, File &file, bela::error_code &ec) {
+  if (b.Size() < directoryHeaderLen) {
+    ec = bela::make_error_code(L"zip: not a valid zip file");
     return false;
   }
-  bela::endian::LittenEndian b(buf, sizeof(buf));
   if (auto n = static_cast<int>(b.Read<uint32_t>()); n != directoryHeaderSignature) {
     ec = bela::make_error_code(L"zip: not a valid zip file");
     return false;
@@ -184,28 +211,32 @@ bool readDirectoryHeader(bufioReader &br, Buffer &buffer, File &file, bela::erro
   b.Discard(4);
   auto externalAttrs = b.Read<uint32_t>();
   file.position = b.Read<uint32_t>();
-  auto totallen = filenameLen + extraLen + commentLen;
-  buffer.grow(totallen);
-  if (br.ReadFull(buffer.data(), totallen, ec) != totallen) {
+  auto totallen = static_cast<size_t>(filenameLen + extraLen + commentLen);
+  if (b.Size() < totallen) {
+    ec = bela::make_error_code(L"zip: not a valid zip file");
     return false;
   }
-  file.name = bela::cstring_view({buffer.data(), filenameLen});
+  auto p = b.Data();
+  b.Discard(totallen);
+  file.name = std::string_view(p, filenameLen);
   if (commentLen != 0) {
-    file.comment = bela::cstring_view({buffer.data() + filenameLen + extraLen, commentLen});
+    file.comment = std::string_view(p + filenameLen + extraLen, commentLen);
   }
   file.mode = resolveFileMode(file, externalAttrs);
   auto needUSize = file.uncompressed_size == SizeMin;
   auto needSize = file.compressed_size == SizeMin;
   auto needOffset = file.position == OffsetMin;
   bela::Time modified;
-  bela::endian::LittenEndian extra(buffer.data() + filenameLen, static_cast<size_t>(extraLen));
+  bela::endian::LittenEndian extra(p + filenameLen, static_cast<size_t>(extraLen));
   for (; extra.Size() >= 4;) {
     auto fieldTag = extra.Read<uint16_t>();
     auto fieldSize = static_cast<int>(extra.Read<uint16_t>());
     if (extra.Size() < static_cast<size_t>(fieldSize)) {
       break;
     }
-    auto fb = extra.Sub(fieldSize);
+    // fields are bounded by hand, the record is followed by the rest of the directory when parsed in place
+    bela::endian::LittenEndian fb(extra.Data(), static_cast<size_t>(fieldSize));
+    extra.Discard(fieldSize);
     if (fieldTag == zip64ExtraID) {
       if (needUSize) {
         needUSize = false;
@@ -244,7 +275,8 @@ bool readDirectoryHeader(bufioReader &br, Buffer &buffer, File &file, bela::erro
         if (fb.Size() < attrSize) {
           break;
         }
-        auto ab = fb.Sub(attrSize);
+        bela::endian::LittenEndian ab(fb.Data(), attrSize);
+        fb.Discard(attrSize);
         if (attrTag != 1 || attrSize != 24) {
           break;
         }
@@ -291,7 +323,7 @@ bool readDirectoryHeader(bufioReader &br, Buffer &buffer, File &file, bela::erro
       file.time = bela::FromUnixSeconds(static_cast<int64_t>(fb.Read<uint32_t>()));
       fb.Discard(4); // discard uid and gid
       if (fb.Size() > 0 && fieldTag == unixExtraID) {
-        file.linkname = bela::cstring_view({fb.Data<char>() + 4, fb.Size()});
+        file.linkname = std::string_view(fb.Data<char>(), fb.Size());
       }
       continue;
     }
@@ -330,7 +362,7 @@ bool readDirectoryHeader(bufioReader &br, Buffer &buffer, File &file, bela::erro
       auto crc32val = fb.Read<uint32_t>();
       (void)crc32val;
       file.flags |= 0x800;
-      file.name = bela::cstring_view({fb.Data<char>(), fb.Size()});
+      file.name = std::string_view(fb.Data<char>(), fb.Size());
       continue;
     }
     if (fieldTag == infoZipUnicodeCommentExtraID) {
@@ -346,7 +378,7 @@ bool readDirectoryHeader(bufioReader &br, Buffer &buffer, File &file, bela::erro
       (void)fb.Pick();
       auto crc32val = fb.Read<uint32_t>();
       (void)crc32val;
-      file.comment = bela::cstring_view({fb.Data<char>(), fb.Size()});
+      file.comment = std::string_view(fb.Data<char>(), fb.Size());
       continue;
     }
     // https://www.winzip.com/win/en/aes_info.html
@@ -373,6 +405,44 @@ bool readDirectoryHeader(bufioReader &br, Buffer &buffer, File &file, bela::erro
   return true;
 }
 
+inline std::string_view arena_copy(std::pmr::memory_resource *arena, std::string_view s) {
+  if (s.empty()) {
+    return {};
+  }
+  auto p = static_cast<char *>(arena->allocate(s.size(), 1));
+  memcpy(p, s.data(), s.size());
+  return {p, s.size()};
+}
+
+// readDirectoryHeader reads one record through br, used when the central directory is not loaded in one piece. The
+// strings of the record are copied into arena, buffer is reused by the next record
+bool readDirectoryHeader(bufioReader &br, Buffer &buffer, std::pmr::memory_resource *arena, File &file,
+                         bela::error_code &ec) {
+  buffer.size() = 0;
+  buffer.grow(directoryHeaderLen);
+  if (br.ReadFull(buffer.data(), directoryHeaderLen, ec) != directoryHeaderLen) {
+    return false;
+  }
+  buffer.size() = directoryHeaderLen;
+  // file name length, extra field length and file comment length are at offset 28
+  bela::endian::LittenEndian lens(buffer.data() + 28, 6);
+  bela::ssize_t totallen = lens.Read<uint16_t>();
+  totallen += lens.Read<uint16_t>();
+  totallen += lens.Read<uint16_t>();
+  buffer.grow(directoryHeaderLen + totallen);
+  if (br.ReadFull(buffer.data() + directoryHeaderLen, totallen, ec) != totallen) {
+    return false;
+  }
+  bela::endian::LittenEndian b(buffer.data(), static_cast<size_t>(directoryHeaderLen + totallen));
+  if (!parseDirectoryHeader(b, file, ec)) {
+    return false;
+  }
+  file.name = arena_copy(arena, file.name);
+  file.comment = arena_copy(arena, file.comment);
+  file.linkname = arena_copy(arena, file.linkname);
+  return true;
+}
+
 bool Reader::Initialize(bela::error_code &ec) {
   if (size == bela::SizeUnInitialized) {
     if ((size = fd.Size(ec)) == bela::SizeUnInitialized) {
@@ -389,7 +459,48 @@ bool Reader::Initialize(bela::error_code &ec) {
     return false;
   }
   files.reserve(d.directoryRecords);
-  if (!fd.Seek(d.directoryOffset + baseOffset, ec)) {
+  if (!readDirectory(d, ec)) {
+    return false;
+  }
+  for (const auto &file : files) {
+    uncompressed_size += file.uncompressed_size;
+    compressed_size += file.compressed_size;
+  }
+  detectCodePage();
+  return true;
+}
+
+// readDirectory loads the whole central directory with a single read into the arena and parses the records in place,
+// the strings of each File are views into that copy. Directories whose declared size is implausible are streamed
+// record by record instead
+bool Reader::readDirectory(const directoryEnd &d, bela::error_code &ec) {
+  auto offset = static_cast<int64_t>(d.directoryOffset) + baseOffset;
+  arena = std::make_unique<std::pmr::monotonic_buffer_resource>();
+  if (d.directorySize >= d.directoryRecords * directoryHeaderLen && d.directorySize <= directoryBulkLimit &&
+      offset + static_cast<int64_t>(d.directorySize) <= size) {
+    auto directorySize = static_cast<size_t>(d.directorySize);
+    auto directory = static_cast<uint8_t *>(arena->allocate(directorySize, 1));
+    if (!fd.ReadAt({directory, directorySize}, offset, ec)) {
+      return false;
+    }
+    bela::endian::LittenEndian b(directory, directorySize);
+    uint64_t i = 0;
+    for (; i < d.directoryRecords; i++) {
+      File file;
+      if (!parseDirectoryHeader(b, file, ec)) {
+        break;
+      }
+      files.emplace_back(std::move(file));
+    }
+    if (i == d.directoryRecords) {
+      return true;
+    }
+    // the declared size disagrees with the records, retry without trusting it
+    files.clear();
+    arena->release();
+    ec.clear();
+  }
+  if (!fd.Seek(offset, ec)) {
     return false;
   }
   // 64K avoid group
@@ -397,16 +508,31 @@ bool Reader::Initialize(bela::error_code &ec) {
   bufioReader br(fd.NativeFD());
   for (uint64_t i = 0; i < d.directoryRecords; i++) {
     File file;
-    if (!readDirectoryHeader(br, buffer, file, ec)) {
+    if (!readDirectoryHeader(br, buffer, arena.get(), file, ec)) {
       return false;
     }
-    uncompressed_size += file.uncompressed_size;
-    compressed_size += file.compressed_size;
     files.emplace_back(std::move(file));
   }
   return true;
 }
 
+// detectCodePage runs the encoding detector once over a sample of the legacy names, a single name is too short for
+// a reliable guess and detecting per entry could decode names of the same archive with different code pages
+void Reader::detectCodePage() {
+  constexpr size_t sampleLimit = 64 * 1024;
+  std::string sample;
+  for (const auto &file : files) {
+    if (file.IsFileNameUTF8() || IsAscii(file.name)) {
+      continue;
+    }
+    if (sample.size() + file.name.size() > sampleLimit) {
+      break;
+    }
+    sample.append(file.name).push_back('\n');
+  }
+  codePage = DetectCodePage(sample);
+}
+
 bool Reader::OpenReader(std::wstring_view file, bela::error_code &ec) {
   if (fd) {
     ec = bela::make_error_code(L"The file has been opened, the function cannot be called repeatedly");
@@ -424,6 +550,39 @@ bool Reader::OpenReader(std::wstring_view file, bela::error_code &ec) {
   return Initialize(ec);
 }
 
+int64_t LocateSelfExtracting(const bela::io::FD &fd, int64_t size, bela::error_code &ec) {
+  auto blen = (std::min)(size, directoryEndSearchLen);
+  bela::Buffer buffer(static_cast<size_t>(blen));
+  if (!fd.ReadAt(buffer, static_cast<size_t>(blen), size - blen, ec)) {
+    return -1;
+  }
+  buffer.size() = static_cast<size_t>(blen);
+  auto p = findSignatureInBlock(buffer.data(), buffer.size());
+  if (p < 0) {
+    return -1;
+  }
+  bela::endian::LittenEndian b(buffer.data() + p + 12, directoryEndLen - 12);
+  auto directorySize = static_cast<int64_t>(b.Read<uint32_t>());
+  auto directoryOffset = static_cast<int64_t>(b.Read<uint32_t>());
+  if (directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF) {
+    // zip64, left to the overlay lookup
+    return -1;
+  }
+  // offsets of an appended zip are relative to its own start, which precedes the central directory
+  auto start = size - blen + p - directorySize - directoryOffset;
+  if (start <= 0) {
+    return -1;
+  }
+  uint32_t signature = 0;
+  if (!fd.ReadAt(signature, start, ec)) {
+    return -1;
+  }
+  if (bela::fromle(signature) != static_cast<uint32_t>(fileHeaderSignature)) {
+    return -1;
+  }
+  return start;
+}
+
 bool Reader::OpenReader(HANDLE nfd, int64_t size_, int64_t offset_, bela::error_code &ec) {
   if (fd) {
     ec = bela::make_error_code(L"The file has been opened, the function cannot be called repeatedly");
@@ -26,6 +26,10 @@ constexpr int dataDescriptorLen = 16;   // four uint32: descriptor signature, cr
 constexpr int dataDescriptor64Len = 24; // descriptor with 8 byte sizes
 constexpr int directory64LocLen = 20;   //
 constexpr int directory64EndLen = 56;   // + extra
+// the end of central directory record and the longest comment it may carry
+constexpr int64_t directoryEndSearchLen = directoryEndLen + 0xFFFF;
+// central directories up to this size are read and parsed in one piece
+constexpr uint64_t directoryBulkLimit = 256 * 1024 * 1024;
 
 // Constants for the first byte in CreatorVersion.
 constexpr int creatorFAT = 0;
@@ -127,6 +131,70 @@ inline bool IsSuperficialPath(std::string_view sv) {
 constexpr size_t outsize = 64 * 1024;
 constexpr size_t insize = 16 * 1024;
 FileMode resolveFileMode(const File &file, uint32_t externalAttrs);
+
+// ReadFullAt reads buffer.size() bytes starting at byte offset pos, the offset is passed with OVERLAPPED so the shared
+// file pointer is neither used nor trusted
+bool ReadFullAt(HANDLE fd, std::span<uint8_t> buffer, int64_t pos, bela::error_code &ec);
+
+// SectionReader reads the compressed data of one entry, each Decompress call owns its cursor so that a Reader can
+// decompress entries from several threads at once. When the archive is memory-mapped, Next hands out spans of the
+// mapping and no bytes are copied. A SectionReader over a StreamReader consumes the stream instead
+class SectionReader {
+public:
+  SectionReader(HANDLE fd_, const MappedView &mv_, int64_t offset_, uint64_t size_)
+      : fd(fd_), mv(&mv_), offset(offset_), remaining(size_) {}
+  SectionReader(StreamReader *stream_, uint64_t size_) : stream(stream_), remaining(size_) {}
+  SectionReader(const SectionReader &) = delete;
+  SectionReader &operator=(const SectionReader &) = delete;
+  [[nodiscard]] uint64_t Remaining() const { return remaining; }
+  [[nodiscard]] bool Mapped() const { return mv != nullptr && static_cast<bool>(*mv); }
+  // Next returns the next n bytes of the section: a span of the mapping when mapped, otherwise the bytes are read
+  // into buffer. Reading past the end of the section is an error
+  bool Next(uint8_t *buffer, size_t n, std::span<const uint8_t> &chunk, bela::error_code &ec) {
+    if (n > remaining) {
+      ec = bela::make_error_code(bela::ErrEOF, L"zip: read beyond the compressed data");
+      return false;
+    }
+    if (stream != nullptr) {
+      if (!stream->readFull(buffer, n, ec)) {
+        return false;
+      }
+      chunk = {buffer, n};
+    } else if (Mapped()) {
+      if (offset + static_cast<int64_t>(n) > mv->Size()) {
+        ec = bela::make_error_code(bela::ErrEOF, L"Reached the end of the file");
+        return false;
+      }
+      chunk = mv->Span(offset, n);
+    } else {
+      if (!ReadFullAt(fd, {buffer, n}, offset, ec)) {
+        return false;
+      }
+      chunk = {buffer, n};
+    }
+    offset += static_cast<int64_t>(n);
+    remaining -= n;
+    return true;
+  }
+  // ReadFull copies buffer.size() bytes and advances the cursor
+  bool ReadFull(std::span<uint8_t> buffer, bela::error_code &ec) {
+    std::span<const uint8_t> chunk;
+    if (!Next(buffer.data(), buffer.size(), chunk, ec)) {
+      return false;
+    }
+    if (chunk.data() != buffer.data()) {
+      memcpy(buffer.data(), chunk.data(), chunk.size());
+    }
+    return true;
+  }
+
+private:
+  HANDLE fd{INVALID_HANDLE_VALUE};
+  const MappedView *mv{nullptr};
+  StreamReader *stream{nullptr};
+  int64_t offset{0};
+  uint64_t remaining{0};
+};
 } // namespace baulk::archive::zip
 
 #endif
\ No newline at end of file
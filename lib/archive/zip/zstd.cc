@@ -6,7 +6,7 @@
 namespace baulk::archive::zip {
 // zstd
 // https://github.com/facebook/zstd/blob/dev/examples/streaming_decompression.c
-bool Reader::decompressZstd(const File &file, const Writer &w, bela::error_code &ec) const {
+bool Reader::decompressZstd(const File &file, SectionReader &sr, const Writer &w, bela::error_code &ec) const {
   const auto boutsize = ZSTD_DStreamOutSize();
   const auto binsize = ZSTD_DStreamInSize();
   Buffer outbuf(boutsize);
@@ -22,10 +22,11 @@ bool Reader::decompressZstd(const File &file, const Writer &w, bela::error_code
   Summator sum(file.crc32_value);
   while (csize != 0) {
     auto minsize = (std::min)(csize, static_cast<uint64_t>(binsize));
-    if (!fd.ReadFull({inbuf.data(), static_cast<size_t>(minsize)}, ec)) {
+    std::span<const uint8_t> chunk;
+    if (!sr.Next(inbuf.data(), static_cast<size_t>(minsize), chunk, ec)) {
       return false;
     }
-    ZSTD_inBuffer in{inbuf.data(), minsize, 0};
+    ZSTD_inBuffer in{chunk.data(), minsize, 0};
     while (in.pos < in.size) {
       ZSTD_outBuffer out{outbuf.data(), boutsize, 0};
       auto result = ZSTD_decompressStream(zds, &out, &in);
@@ -5,97 +5,303 @@
 #include <bela/hash.hpp>
 #include <bela/ascii.hpp>
 #include <baulk/hash.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 namespace baulk::hash {
 
-template <typename Hasher> struct Sumizer {
-  Hasher hasher;
-  bool filechecksum(const std::filesystem::path &file, std::wstring &hv, bela::error_code &ec) {
-    HANDLE FileHandle = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
-                                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (FileHandle == INVALID_HANDLE_VALUE) {
-      ec = bela::make_system_error_code();
+// hasher_state_version is the layout revision of the raw hasher state saved with part downloads, bump it whenever
+// bela changes the fields of that hasher
+template <typename H> struct hasher_state_version;
+template <> struct hasher_state_version<bela::hash::sha256::Hasher> : std::integral_constant<uint16_t, 1> {};
+template <> struct hasher_state_version<bela::hash::sha512::Hasher> : std::integral_constant<uint16_t, 1> {};
+template <> struct hasher_state_version<bela::hash::sha3::Hasher> : std::integral_constant<uint16_t, 1> {};
+template <> struct hasher_state_version<bela::hash::blake3::Hasher> : std::integral_constant<uint16_t, 1> {};
+
+template <typename H> class HasherAdapter final : public Hasher {
+  static_assert(std::is_trivially_copyable_v<H>, "hasher state must be copyable as bytes");
+
+public:
+  template <typename... Args> HasherAdapter(Args... args) { h.Initialize(args...); }
+  void Update(const void *data, size_t len) override { h.Update(data, len); }
+  void UpdateParallel(const void *data, size_t len, uint32_t threads) override {
+    if constexpr (requires { h.UpdateParallel(data, len, threads); }) {
+      h.UpdateParallel(data, len, threads);
+    } else {
+      h.Update(data, len);
+    }
+  }
+  std::wstring Finalize() override { return h.Finalize(); }
+  std::string_view State() const override { return {reinterpret_cast<const char *>(&h), sizeof(H)}; }
+  uint16_t StateVersion() const override { return hasher_state_version<H>::value; }
+  bool Restore(std::string_view state, uint16_t version) override {
+    if (version != hasher_state_version<H>::value || state.size() != sizeof(H)) {
       return false;
     }
-    auto closer = bela::finally([&] { CloseHandle(FileHandle); });
-    uint8_t bytes[32678];
-    for (;;) {
+    memcpy(&h, state.data(), sizeof(H));
+    return true;
+  }
+
+private:
+  H h;
+};
+
+std::unique_ptr<Hasher> NewHasher(hash_t method) {
+  using namespace bela::hash;
+  switch (method) {
+  case hash_t::SHA224:
+    return std::make_unique<HasherAdapter<sha256::Hasher>>(sha256::HashBits::SHA224);
+  case hash_t::SHA256:
+    return std::make_unique<HasherAdapter<sha256::Hasher>>();
+  case hash_t::SHA384:
+    return std::make_unique<HasherAdapter<sha512::Hasher>>(sha512::HashBits::SHA384);
+  case hash_t::SHA512:
+    return std::make_unique<HasherAdapter<sha512::Hasher>>();
+  case hash_t::SHA3_224:
+    return std::make_unique<HasherAdapter<sha3::Hasher>>(sha3::HashBits::SHA3224);
+  case hash_t::SHA3_256:
+    [[fallthrough]];
+  case hash_t::SHA3:
+    return std::make_unique<HasherAdapter<sha3::Hasher>>();
+  case hash_t::SHA3_384:
+    return std::make_unique<HasherAdapter<sha3::Hasher>>(sha3::HashBits::SHA3384);
+  case hash_t::SHA3_512:
+    return std::make_unique<HasherAdapter<sha3::Hasher>>(sha3::HashBits::SHA3512);
+  case hash_t::BLAKE3:
+    return std::make_unique<HasherAdapter<blake3::Hasher>>();
+  default:
+    break;
+  }
+  return nullptr;
+}
+
+// files at least this large are mapped, each hasher walks the whole mapping and BLAKE3 also splits its subtrees
+constexpr int64_t parallel_hash_min_size = 64 * 1024 * 1024;
+// ring blocks are page aligned and large enough that one ReadFile per block keeps the disk busy, a ring holds at most
+// hash_ring_blocks of them and fewer when FileHashes runs on a small thread budget
+constexpr size_t hash_block_size = 1024 * 1024;
+constexpr size_t hash_ring_blocks = 8;
+
+// mapped_file maps a whole file read-only, Map fails for files too small to be worth it
+class mapped_file {
+public:
+  mapped_file() = default;
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+  ~mapped_file() {
+    if (data != nullptr) {
+      UnmapViewOfFile(data);
+    }
+    if (fm != nullptr) {
+      CloseHandle(fm);
+    }
+  }
+  bool Map(HANDLE fd, int64_t fileSize) {
+    if (fileSize < parallel_hash_min_size || static_cast<uint64_t>(fileSize) > (std::numeric_limits<size_t>::max)()) {
+      return false;
+    }
+    if (fm = CreateFileMappingW(fd, nullptr, PAGE_READONLY, 0, 0, nullptr); fm == nullptr) {
+      return false;
+    }
+    if (data = static_cast<const uint8_t *>(MapViewOfFile(fm, FILE_MAP_READ, 0, 0, 0)); data == nullptr) {
+      return false;
+    }
+    size = static_cast<size_t>(fileSize);
+    return true;
+  }
+  const uint8_t *data{nullptr};
+  size_t size{0};
+
+private:
+  HANDLE fm{nullptr};
+};
+
+// hash_ring hands every block read from the file to each hasher in order, a block is reused once all of them have
+// consumed it
+class hash_ring {
+public:
+  hash_ring(size_t hashers, size_t depth) : blocks(depth), consumed(hashers, 0) {
+    for (auto &b : blocks) {
+      b.data.reset(new (std::align_val_t{4096}) uint8_t[hash_block_size]);
+    }
+  }
+  hash_ring(const hash_ring &) = delete;
+  hash_ring &operator=(const hash_ring &) = delete;
+  // produce fills the ring from fd until the end of file, the hashers are released on error as well
+  bool produce(HANDLE fd, bela::error_code &ec) {
+    for (uint64_t seq = 0;; seq++) {
+      auto &b = blocks[seq % blocks.size()];
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&] { return seq - slowest() < blocks.size(); });
+      }
       DWORD dwread = 0;
-      if (ReadFile(FileHandle, bytes, sizeof(bytes), &dwread, nullptr) != TRUE) {
+      if (ReadFile(fd, b.data.get(), static_cast<DWORD>(hash_block_size), &dwread, nullptr) != TRUE) {
         ec = bela::make_system_error_code();
+        finish(true);
         return false;
       }
-      hasher.Update(bytes, static_cast<size_t>(dwread));
-      if (dwread < sizeof(bytes)) {
-        break;
+      if (dwread == 0) {
+        finish(false);
+        return true;
       }
+      b.size = dwread;
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        produced++;
+      }
+      cv.notify_all();
+    }
+  }
+  // consume feeds hasher i every block in order, it returns after the last block or when the reader failed
+  void consume(size_t i, Hasher &h) {
+    for (;;) {
+      const block *b = nullptr;
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&] { return failed || consumed[i] < produced || ended; });
+        if (failed || consumed[i] == produced) {
+          return;
+        }
+        b = &blocks[consumed[i] % blocks.size()];
+      }
+      h.Update(b->data.get(), b->size);
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        consumed[i]++;
+      }
+      cv.notify_all();
     }
-    hv = hasher.Finalize();
-    return true;
   }
-  std::optional<std::wstring> operator()(const std::filesystem::path &file, bela::error_code &ec) {
-    std::wstring hv;
-    if (filechecksum(file, hv, ec)) {
-      return std::make_optional(std::move(hv));
+
+private:
+  struct aligned_delete {
+    void operator()(uint8_t *p) const { ::operator delete[](p, std::align_val_t{4096}); }
+  };
+  struct block {
+    std::unique_ptr<uint8_t[], aligned_delete> data;
+    size_t size{0};
+  };
+  uint64_t slowest() const { return *std::min_element(consumed.begin(), consumed.end()); }
+  void finish(bool failed_) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      ended = true;
+      failed = failed_;
     }
-    return std::nullopt;
+    cv.notify_all();
   }
+  std::vector<block> blocks;
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::vector<uint64_t> consumed;
+  uint64_t produced{0};
+  bool ended{false};
+  bool failed{false};
 };
 
-std::optional<std::wstring> FileHash(const std::filesystem::path &file, hash_t method, bela::error_code &ec) {
-  switch (method) {
-  case hash_t::SHA224: {
-    Sumizer<bela::hash::sha256::Hasher> sumizer;
-    sumizer.hasher.Initialize(bela::hash::sha256::HashBits::SHA224);
-    return sumizer(file, ec);
-  }
-  case hash_t::SHA256: {
-    Sumizer<bela::hash::sha256::Hasher> sumizer;
-    sumizer.hasher.Initialize();
-    return sumizer(file, ec);
-  }
-  case hash_t::SHA384: {
-    Sumizer<bela::hash::sha512::Hasher> sumizer;
-    sumizer.hasher.Initialize(bela::hash::sha512::HashBits::SHA384);
-    return sumizer(file, ec);
-  }
-  case hash_t::SHA512: {
-    Sumizer<bela::hash::sha512::Hasher> sumizer;
-    sumizer.hasher.Initialize();
-    return sumizer(file, ec);
-  }
-  case hash_t::SHA3_224: {
-    Sumizer<bela::hash::sha3::Hasher> sumizer;
-    sumizer.hasher.Initialize(bela::hash::sha3::HashBits::SHA3224);
-    return sumizer(file, ec);
+std::optional<std::vector<std::wstring>> FileHashes(const std::filesystem::path &file, std::span<const hash_t> methods,
+                                                    uint32_t threads, bela::error_code &ec) {
+  if (methods.empty()) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"no hash method");
+    return std::nullopt;
   }
-  case hash_t::SHA3_256:
-    [[fallthrough]];
-  case hash_t::SHA3: {
-    Sumizer<bela::hash::sha3::Hasher> sumizer;
-    sumizer.hasher.Initialize();
-    return sumizer(file, ec);
-  }
-  case hash_t::SHA3_384: {
-    Sumizer<bela::hash::sha3::Hasher> sumizer;
-    sumizer.hasher.Initialize(bela::hash::sha3::HashBits::SHA3384);
-    return sumizer(file, ec);
-  }
-  case hash_t::SHA3_512: {
-    Sumizer<bela::hash::sha3::Hasher> sumizer;
-    sumizer.hasher.Initialize(bela::hash::sha3::HashBits::SHA3512);
-    return sumizer(file, ec);
-  }
-  case hash_t::BLAKE3: {
-    Sumizer<bela::hash::blake3::Hasher> sumizer;
-    sumizer.hasher.Initialize();
-    return sumizer(file, ec);
+  std::vector<std::unique_ptr<Hasher>> hashers;
+  for (auto m : methods) {
+    auto h = NewHasher(m);
+    if (!h) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"unkown hash method: ", static_cast<int>(m));
+      return std::nullopt;
+    }
+    hashers.emplace_back(std::move(h));
   }
-  default:
-    break;
+  HANDLE FileHandle = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (FileHandle == INVALID_HANDLE_VALUE) {
+    ec = bela::make_system_error_code();
+    return std::nullopt;
+  }
+  auto closer = bela::finally([&] { CloseHandle(FileHandle); });
+  LARGE_INTEGER li;
+  if (GetFileSizeEx(FileHandle, &li) != TRUE) {
+    ec = bela::make_system_error_code();
+    return std::nullopt;
+  }
+  auto finalize = [&]() {
+    std::vector<std::wstring> digests;
+    for (auto &h : hashers) {
+      digests.emplace_back(h->Finalize());
+    }
+    return std::make_optional(std::move(digests));
+  };
+  auto budget = threads != 0 ? threads : (std::max)(std::thread::hardware_concurrency(), 1u);
+  if (mapped_file mf; mf.Map(FileHandle, li.QuadPart)) {
+    if (budget < hashers.size()) {
+      // not enough threads for one hasher each, they walk the mapping one after another
+      for (auto &h : hashers) {
+        h->UpdateParallel(mf.data, mf.size, 1);
+      }
+      return finalize();
+    }
+    // serial hashers take one thread each, the threads left over go to the ones able to split their input
+    auto spare = budget - static_cast<uint32_t>(hashers.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < hashers.size(); i++) {
+      workers.emplace_back([&, i] { hashers[i]->UpdateParallel(mf.data, mf.size, 1 + spare); });
+    }
+    hashers[0]->UpdateParallel(mf.data, mf.size, 1 + spare);
+    for (auto &w : workers) {
+      w.join();
+    }
+    return finalize();
+  }
+  if (budget <= hashers.size() || (hashers.size() == 1 && li.QuadPart <= static_cast<int64_t>(hash_block_size))) {
+    // a single small read, or no thread left for the reader: threads would cost more than they save
+    auto buffer = std::make_unique<uint8_t[]>(hash_block_size);
+    for (;;) {
+      DWORD dwread = 0;
+      if (ReadFile(FileHandle, buffer.get(), static_cast<DWORD>(hash_block_size), &dwread, nullptr) != TRUE) {
+        ec = bela::make_system_error_code();
+        return std::nullopt;
+      }
+      if (dwread == 0) {
+        break;
+      }
+      for (auto &h : hashers) {
+        h->Update(buffer.get(), dwread);
+      }
+    }
+    return finalize();
+  }
+  // the reader may run ahead of the slowest hasher by one block per thread of the budget
+  hash_ring ring(hashers.size(), (std::min)(static_cast<size_t>(budget), hash_ring_blocks));
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < hashers.size(); i++) {
+    workers.emplace_back([&, i] { ring.consume(i, *hashers[i]); });
+  }
+  auto result = ring.produce(FileHandle, ec);
+  for (auto &w : workers) {
+    w.join();
   }
-  ec = bela::make_error_code(bela::ErrGeneral, L"unkown hash method: ", static_cast<int>(method));
-  return std::nullopt;
+  if (!result) {
+    return std::nullopt;
+  }
+  return finalize();
+}
+
+std::optional<std::wstring> FileHash(const std::filesystem::path &file, hash_t method, uint32_t threads,
+                                     bela::error_code &ec) {
+  auto digests = FileHashes(file, std::span<const hash_t>(&method, 1), threads, ec);
+  if (!digests) {
+    return std::nullopt;
+  }
+  return std::make_optional(std::move(digests->front()));
 }
 
 struct HashPrefix {
@@ -114,25 +320,30 @@ constexpr HashPrefix hnmaps[] = {
     {L"SHA3-512", hash_t::SHA3_512}, // SHA3-512
     {L"SHA3", hash_t::SHA3},         // SHA3 alias for SHA3-256
 };
+bool ParseHashValue(std::wstring_view hash_value, hash_t &method, std::wstring_view &value, bela::error_code &ec) {
+  value = hash_value;
+  method = hash_t::SHA256;
+  auto pos = hash_value.find(':');
+  if (pos == std::wstring_view::npos) {
+    return true;
+  }
+  value = hash_value.substr(pos + 1);
+  auto prefix = bela::AsciiStrToUpper(hash_value.substr(0, pos));
+  for (const auto &h : hnmaps) {
+    if (h.prefix == prefix) {
+      method = h.method;
+      return true;
+    }
+  }
+  ec = bela::make_error_code(bela::ErrGeneral, L"unsupported hash method '", prefix, L"'");
+  return false;
+}
+
 bool HashEqual(const std::filesystem::path &file, std::wstring_view hash_value, bela::error_code &ec) {
-  std::wstring_view value = hash_value;
+  std::wstring_view value;
   auto m = hash_t::SHA256;
-  if (auto pos = hash_value.find(':'); pos != std::wstring_view::npos) {
-    value = hash_value.substr(pos + 1);
-    auto prefix = bela::AsciiStrToUpper(hash_value.substr(0, pos));
-    auto fn = [&]() {
-      for (const auto &h : hnmaps) {
-        if (h.prefix == prefix) {
-          m = h.method;
-          return true;
-        }
-      }
-      return false;
-    };
-    if (!fn()) {
-      ec = bela::make_error_code(bela::ErrGeneral, L"unsupported hash method '", prefix, L"'");
-      return false;
-    }
+  if (!ParseHashValue(hash_value, m, value, ec)) {
+    return false;
   }
   auto ha = FileHash(file, m, ec);
   if (!ha) {
@@ -146,31 +357,13 @@ bool HashEqual(const std::filesystem::path &file, std::wstring_view hash_value,
 }
 
 std::optional<file_hash_sums> HashSums(const std::filesystem::path &file, bela::error_code &ec) {
-  HANDLE FileHandle = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
-                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-  if (FileHandle == INVALID_HANDLE_VALUE) {
-    ec = bela::make_system_error_code();
+  constexpr hash_t methods[] = {hash_t::SHA256, hash_t::BLAKE3};
+  auto digests = FileHashes(file, methods, ec);
+  if (!digests) {
     return std::nullopt;
   }
-  bela::hash::sha256::Hasher s;
-  bela::hash::blake3::Hasher b;
-  s.Initialize();
-  b.Initialize();
-  auto closer = bela::finally([&] { CloseHandle(FileHandle); });
-  uint8_t bytes[32678];
-  for (;;) {
-    DWORD dwread = 0;
-    if (ReadFile(FileHandle, bytes, sizeof(bytes), &dwread, nullptr) != TRUE) {
-      ec = bela::make_system_error_code();
-      return std::nullopt;
-    }
-    s.Update(bytes, static_cast<size_t>(dwread));
-    b.Update(bytes, static_cast<size_t>(dwread));
-    if (dwread < sizeof(bytes)) {
-      break;
-    }
-  }
-  return std::make_optional(file_hash_sums{.sha256sum = s.Finalize(), .blake3sum = b.Finalize()});
+  return std::make_optional(
+      file_hash_sums{.sha256sum = std::move((*digests)[0]), .blake3sum = std::move((*digests)[1])});
 }
 
 } // namespace baulk::hash
@@ -4,6 +4,8 @@
 #include <baulk/indicators.hpp>
 #include "native.hpp"
 #include "file.hpp"
+#include <thread>
+#include <mutex>
 
 namespace baulk::net {
 
@@ -68,6 +70,9 @@ void response_trace(minimal_response &resp) {
 }
 
 using baulk::net::native::make_net_error_code;
+HttpClient::HttpClient() : pool(std::make_unique<native::session_pool>()) {}
+HttpClient::~HttpClient() = default;
+
 bool HttpClient::IsNoProxy(std::wstring_view host) const {
   for (const auto &u : noProxy) {
     if (bela::EqualsIgnoreCase(u, host)) {
@@ -100,24 +105,20 @@ std::optional<Response> HttpClient::WinRest(std::wstring_view method, std::wstri
   if (!u) {
     return std::nullopt;
   }
-  auto session = native::make_session(userAgent, ec);
-  if (!session) {
-    return std::nullopt;
-  }
-  if (!IsNoProxy(u->host)) {
-    session->set_proxy_url(proxyURL);
-  }
-  session->protocol_enable();
-  auto conn = session->connect(u->host, u->nPort, ec);
+  bool reused = false;
+  auto conn = pool->acquire(*u, userAgent, IsNoProxy(u->host) ? L"" : proxyURL, reused, ec);
   if (!conn) {
     return std::nullopt;
   }
+  if (reused) {
+    DbgPrint(L"Reuse the session of %s:%d", u->host, u->nPort);
+  }
   auto flags = u->TlsFlag();
   if (noCache) {
     DbgPrint(L"Indicates that the request should be forwarded to the originating server");
     flags |= WINHTTP_FLAG_REFRESH;
   }
-  auto req = conn->open_request(method, u->uri, flags, ec);
+  auto req = conn->conn.open_request(method, u->uri, flags, ec);
   if (!req) {
     return std::nullopt;
   }
@@ -191,30 +192,257 @@ void WINAPI status_context_callback(HINTERNET hInternet, DWORD_PTR dwContext, DW
   }
 }
 
-std::optional<std::filesystem::path> HttpClient::WinGet(std::wstring_view url, const download_options &opts,
-                                                        bela::error_code &ec) {
-  auto u = native::crack_url(url, ec);
-  if (!u) {
-    return std::nullopt;
+// download_hashers digests the body of a download as it is written, their states are saved with part downloads
+class download_hashers {
+public:
+  bool initialize(const std::vector<baulk::hash::hash_t> &methods_, bela::error_code &ec) {
+    methods = methods_;
+    return reset(ec);
+  }
+  bool reset(bela::error_code &ec) {
+    hashers.clear();
+    for (auto m : methods) {
+      auto h = baulk::hash::NewHasher(m);
+      if (!h) {
+        ec = bela::make_error_code(bela::ErrGeneral, L"unsupported hash method: ", static_cast<int>(m));
+        return false;
+      }
+      hashers.emplace_back(std::move(h));
+    }
+    return true;
+  }
+  void update(const void *data, size_t len) {
+    for (auto &h : hashers) {
+      h->Update(data, len);
+    }
+  }
+  std::string encode() const {
+    std::string states;
+    for (size_t i = 0; i < hashers.size(); i++) {
+      auto state = hashers[i]->State();
+      net_internal::part_hasher_state hs{.method = static_cast<uint16_t>(methods[i]),
+                                         .version = hashers[i]->StateVersion(),
+                                         .size = static_cast<uint32_t>(state.size())};
+      states.append(reinterpret_cast<const char *>(&hs), sizeof(hs));
+      states.append(state);
+    }
+    return states;
+  }
+  // restore resumes every hasher from the states saved with the part, it fails when one of them has no state
+  bool restore(std::string_view states) {
+    std::vector<std::string_view> found(hashers.size());
+    std::vector<uint16_t> versions(hashers.size(), 0);
+    while (states.size() >= sizeof(net_internal::part_hasher_state)) {
+      net_internal::part_hasher_state hs;
+      memcpy(&hs, states.data(), sizeof(hs));
+      states.remove_prefix(sizeof(hs));
+      if (states.size() < hs.size) {
+        return false;
+      }
+      for (size_t i = 0; i < methods.size(); i++) {
+        if (static_cast<uint16_t>(methods[i]) == hs.method) {
+          found[i] = states.substr(0, hs.size);
+          versions[i] = hs.version;
+        }
+      }
+      states.remove_prefix(hs.size);
+    }
+    for (size_t i = 0; i < hashers.size(); i++) {
+      if (!hashers[i]->Restore(found[i], versions[i])) {
+        return false;
+      }
+    }
+    return true;
   }
+  std::vector<std::wstring> finalize() {
+    std::vector<std::wstring> digests;
+    for (auto &h : hashers) {
+      digests.emplace_back(h->Finalize());
+    }
+    return digests;
+  }
+
+private:
+  std::vector<baulk::hash::hash_t> methods;
+  std::vector<std::unique_ptr<baulk::hash::Hasher>> hashers;
+};
+
+// recv_range writes the body of h at the offsets of segment until the segment is complete
+bool recv_range(HINTERNET h, net_internal::FilePart &part, const net_internal::part_segment &segment,
+                std::atomic_int64_t &received, const std::atomic_bool &stopped, bela::error_code &ec) {
+  std::vector<char> buffer(64 * 1024);
+  auto pos = segment.start + received.load();
+  while (pos < segment.end) {
+    if (stopped) {
+      ec = bela::make_error_code(bela::ErrCanceled, L"canceled");
+      return false;
+    }
+    DWORD dwSize = 0;
+    if (WinHttpQueryDataAvailable(h, &dwSize) != TRUE) {
+      ec = make_net_error_code();
+      return false;
+    }
+    if (dwSize == 0) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"connection has been disconnected");
+      return false;
+    }
+    // the probing request continues past its segment
+    auto len = (std::min)(static_cast<int64_t>((std::min)(static_cast<size_t>(dwSize), buffer.size())),
+                          segment.end - pos);
+    DWORD downloaded_size = 0;
+    if (WinHttpReadData(h, buffer.data(), static_cast<DWORD>(len), &downloaded_size) != TRUE) {
+      ec = make_net_error_code();
+      return false;
+    }
+    if (!part.WriteAt(buffer.data(), static_cast<size_t>(downloaded_size), pos, ec)) {
+      return false;
+    }
+    pos += downloaded_size;
+    received += downloaded_size;
+  }
+  return true;
+}
+
+bool HttpClient::get_range(const native::url &u, net_internal::FilePart &part,
+                           const net_internal::part_segment &segment, std::atomic_int64_t &received,
+                           const std::atomic_bool &stopped, bela::error_code &ec) {
+  // one session per segment: requests of a session share an HTTP/2 connection
   auto session = native::make_session(userAgent, ec);
   if (!session) {
-    return std::nullopt;
+    return false;
   }
-  if (!IsNoProxy(u->host)) {
+  if (!IsNoProxy(u.host)) {
     session->set_proxy_url(proxyURL);
   }
   session->protocol_enable();
-  auto conn = session->connect(u->host, u->nPort, ec);
+  auto conn = session->connect(u.host, u.nPort, ec);
+  if (!conn) {
+    return false;
+  }
+  // same request flags as the probing request
+  auto flags = u.TlsFlag();
+  if (noCache) {
+    flags |= WINHTTP_FLAG_REFRESH;
+  }
+  auto req = conn->open_request(L"GET", u.uri, flags, ec);
+  if (!req) {
+    return false;
+  }
+  if (insecureMode) {
+    req->set_insecure_mode();
+  }
+  if (!req->write_range_headers(hkv, cookies, segment.start + received.load(), segment.end - 1, ec)) {
+    return false;
+  }
+  if (!req->write_body(L"", L"", ec)) {
+    return false;
+  }
+  auto mr = req->recv_minimal_response(ec);
+  if (!mr) {
+    return false;
+  }
+  if (mr->status_code != 206) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"range response: ", mr->status_code, L" status: ", mr->status_text);
+    return false;
+  }
+  return recv_range(req->addressof(), part, segment, received, stopped, ec);
+}
+
+bool HttpClient::segmented_get(const native::url &u, native::handle *first, net_internal::FilePart &part,
+                               std::vector<net_internal::part_segment> &segments, std::wstring_view name,
+                               bela::error_code &ec) {
+  std::vector<std::atomic_int64_t> received(segments.size());
+  for (size_t i = 0; i < segments.size(); i++) {
+    received[i] = segments[i].received;
+  }
+  auto current_bytes = [&]() {
+    int64_t n = 0;
+    for (const auto &r : received) {
+      n += r.load();
+    }
+    return n;
+  };
+  DbgPrint(L"%s download in %d segments", name, segments.size());
+  baulk::ProgressBar bar;
+  bar.Maximum(static_cast<uint64_t>(segments.back().end));
+  bar.FileName(name);
+  bar.Execute();
+  auto finish = bela::finally([&] {
+    // finish progressbar
+    bar.Finish();
+  });
+  std::mutex mtx;
+  std::atomic_bool stopped{false};
+  std::atomic_size_t running{0};
+  bela::error_code firstEc;
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < segments.size(); i++) {
+    if (segments[i].start + segments[i].received >= segments[i].end) {
+      continue;
+    }
+    running++;
+    workers.emplace_back([&, i] {
+      bela::error_code workerEc;
+      auto result = (i == 0 && first != nullptr)
+                        ? recv_range(first->addressof(), part, segments[i], received[i], stopped, workerEc)
+                        : get_range(u, part, segments[i], received[i], stopped, workerEc);
+      if (!result) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!firstEc) {
+          firstEc = std::move(workerEc);
+        }
+        stopped = true;
+      }
+      running--;
+    });
+  }
+  while (running > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    bar.Update(static_cast<uint64_t>(current_bytes()));
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  for (size_t i = 0; i < segments.size(); i++) {
+    segments[i].received = received[i];
+  }
+  if (stopped) {
+    bar.MarkFault();
+    bar.MarkCompleted();
+    ec = std::move(firstEc);
+    return false;
+  }
+  bar.Update(static_cast<uint64_t>(current_bytes()));
+  bar.MarkCompleted();
+  return true;
+}
+
+std::optional<std::filesystem::path> HttpClient::WinGet(std::wstring_view url, const download_options &opts,
+                                                        bela::error_code &ec) {
+  std::vector<std::wstring> digests;
+  return WinGet(url, opts, digests, ec);
+}
+
+std::optional<std::filesystem::path> HttpClient::WinGet(std::wstring_view url, const download_options &opts,
+                                                        std::vector<std::wstring> &digests, bela::error_code &ec) {
+  auto u = native::crack_url(url, ec);
+  if (!u) {
+    return std::nullopt;
+  }
+  bool reused = false;
+  auto conn = pool->acquire(*u, userAgent, IsNoProxy(u->host) ? L"" : proxyURL, reused, ec);
   if (!conn) {
     return std::nullopt;
   }
+  if (reused) {
+    DbgPrint(L"Reuse the session of %s:%d", u->host, u->nPort);
+  }
   auto flags = u->TlsFlag();
   if (noCache) {
     DbgPrint(L"Indicates that the request should be forwarded to the originating server");
     flags |= WINHTTP_FLAG_REFRESH;
   }
-  auto req = conn->open_request(L"GET", u->uri, flags, ec);
+  auto req = conn->conn.open_request(L"GET", u->uri, flags, ec);
   if (!req) {
     return std::nullopt;
   }
@@ -222,12 +450,22 @@ std::optional<std::filesystem::path> HttpClient::WinGet(std::wstring_view url, c
     req->set_insecure_mode();
   }
   auto destination = make_destination(opts, *u);
-  auto filePart = net_internal::FilePart::MakeFilePart(destination, opts.hash_value, ec);
+  // without a hash value only a segment table can be resumed, the part is then keyed on the URL and the size
+  auto part_key = !opts.hash_value.empty() || opts.connections <= 1 || opts.sink ? opts.hash_value
+                                                                                 : net_internal::url_part_key(url);
+  auto filePart = net_internal::FilePart::MakeFilePart(destination, part_key, ec);
   if (!filePart) {
     return std::nullopt;
   }
+  download_hashers hashers;
+  if (!hashers.initialize(opts.hash_methods, ec)) {
+    return std::nullopt;
+  }
+  // a segmented part resumes segment by segment, the first request only probes the server
+  std::vector<net_internal::part_segment> segments;
+  auto segmented_part = net_internal::decode_segments(filePart->States(), segments);
   // detect part download
-  if (!req->write_headers(hkv, cookies, filePart->CurrentBytes(), filePart->FileSize(), ec)) {
+  if (!req->write_headers(hkv, cookies, segmented_part ? 0 : filePart->CurrentBytes(), filePart->FileSize(), ec)) {
     return std::nullopt;
   }
   native::status_context sc(debugMode);
@@ -269,6 +507,36 @@ std::optional<std::filesystem::path> HttpClient::WinGet(std::wstring_view url, c
     ec = bela::make_error_code(bela::ErrGeneral, L"response: ", mr->status_code, L" status: ", mr->status_text);
     return std::nullopt;
   }
+  if (mr->status_code == 200 && opts.connections > 1 && !opts.sink && native::enable_part_download(mr->headers) &&
+      total_size > 0) {
+    auto resumed = segmented_part && filePart->FileSize() == total_size;
+    if (!resumed) {
+      segments = net_internal::make_segments(total_size, opts.connections);
+    }
+    if (segments.size() > 1) {
+      if (!resumed && !filePart->Preallocate(total_size, ec)) {
+        return std::nullopt;
+      }
+      auto location = sc.crack_location_url();
+      if (!segmented_get(location ? *location : *u, resumed ? nullptr : &*req, *filePart, segments,
+                         destination.filename().native(), ec)) {
+        if (!part_key.empty()) {
+          std::string states;
+          net_internal::encode_segments(segments, states);
+          bela::error_code discard_ec;
+          filePart->SaveOverlayData(part_key, total_size, total_size, states, discard_ec);
+        }
+        return std::nullopt;
+      }
+      // segments arrive out of order, the complete file is hashed once
+      if (!filePart->ReadPart([&](const void *data, size_t len) { hashers.update(data, len); }, ec)) {
+        return std::nullopt;
+      }
+      filePart->Solidified(ec);
+      digests = hashers.finalize();
+      return std::make_optional(std::move(destination));
+    }
+  }
   if (mr->status_code != 206) {
     if (!filePart->Truncated(ec)) {
       return std::nullopt;
@@ -277,6 +545,13 @@ std::optional<std::filesystem::path> HttpClient::WinGet(std::wstring_view url, c
   } else {
     total_size += filePart->CurrentBytes();
     DbgPrint(L"%s download from bytes: %d", u->filename, filePart->CurrentBytes());
+    if (!hashers.restore(filePart->States())) {
+      DbgPrint(L"%s hash the downloaded bytes again", u->filename);
+      if (!hashers.reset(ec) ||
+          !filePart->ReadPart([&](const void *data, size_t len) { hashers.update(data, len); }, ec)) {
+        return std::nullopt;
+      }
+    }
   }
   // Pare progress bar
   baulk::ProgressBar bar;
@@ -290,13 +565,14 @@ std::optional<std::filesystem::path> HttpClient::WinGet(std::wstring_view url, c
     bar.Finish();
   });
   int64_t current_bytes = filePart->CurrentBytes();
+  bool feed_sink = opts.sink && mr->status_code != 206;
 
   auto save_part_overlay = [&] {
     if (!part_support) {
       return;
     }
     bela::error_code discard_ec;
-    filePart->SaveOverlayData(opts.hash_value, total_size, current_bytes, discard_ec);
+    filePart->SaveOverlayData(opts.hash_value, total_size, current_bytes, hashers.encode(), discard_ec);
     DbgPrint(L"%s download broken for bytes: %d-%d", u->filename, current_bytes, total_size);
   };
   // recv data
@@ -321,6 +597,10 @@ std::optional<std::filesystem::path> HttpClient::WinGet(std::wstring_view url, c
       return std::nullopt;
     }
     filePart->WriteFull(buffer.data(), static_cast<size_t>(downloaded_size), ec);
+    hashers.update(buffer.data(), static_cast<size_t>(downloaded_size));
+    if (feed_sink && downloaded_size != 0) {
+      opts.sink(buffer.data(), static_cast<size_t>(downloaded_size));
+    }
     current_bytes += dwSize;
     bar.Update(current_bytes);
   } while (dwSize > 0);
@@ -334,6 +614,7 @@ std::optional<std::filesystem::path> HttpClient::WinGet(std::wstring_view url, c
   }
   filePart->Solidified(ec);
   bar.MarkCompleted();
+  digests = hashers.finalize();
   return std::make_optional(std::move(destination));
 }
 } // namespace baulk::net
\ No newline at end of file
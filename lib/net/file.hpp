@@ -4,7 +4,9 @@
 #include <bela/time.hpp>
 #include <bela/ascii.hpp>
 #include <bela/io.hpp>
+#include <bela/hash.hpp>
 #include <filesystem>
+#include <vector>
 #include <baulk/allocate.hpp>
 #include <baulk/net/types.hpp>
 
@@ -20,11 +22,13 @@ enum class hash_t : uint16_t {
   SHA3_256,   //
   SHA3_384,   //
   SHA3_512,   //
-  BLAKE3
+  BLAKE3,     //
+  URL         // segmented downloads without a hash value, keyed on the SHA-256 of the URL
 };
 
 constexpr std::wstring_view part_suffix = L".part";
-constexpr uint8_t part_magic[] = {'P', 'A', 'R', 'T'};
+// the hasher states of the download (state_bytes) are stored between the received bytes and the overlay
+constexpr uint8_t part_magic[] = {'P', 'A', 'R', '3'};
 #pragma pack(push, 1)
 struct part_overlay_data {
   uint8_t magic[4];
@@ -34,9 +38,63 @@ struct part_overlay_data {
   int64_t total_bytes{0};
   int64_t current_bytes{0};
   int64_t laste_time{0};
+  uint32_t state_bytes{0};
+};
+// part_hasher_state precedes the state of each hasher
+struct part_hasher_state {
+  uint16_t method{0};
+  uint16_t version{0}; // Hasher::StateVersion(), 0 for the segment table
+  uint32_t size{0};
+};
+// a segmented download stores its segment table as a state with this method
+constexpr uint16_t part_segments_method = 0xFFFF;
+// part_segment is a range [start, end) of a segmented download, received bytes are counted from start
+struct part_segment {
+  int64_t start{0};
+  int64_t end{0};
+  int64_t received{0};
 };
 #pragma pack(pop)
 
+// segments smaller than this are not worth another connection
+constexpr int64_t part_segment_min_size = 4 * 1024 * 1024;
+
+inline std::vector<part_segment> make_segments(int64_t total_size, uint32_t connections) {
+  auto n = (std::min)(static_cast<int64_t>(connections), (std::max)(total_size / part_segment_min_size, int64_t{1}));
+  std::vector<part_segment> segments;
+  auto size = total_size / n;
+  for (int64_t i = 0; i < n; i++) {
+    segments.emplace_back(part_segment{.start = i * size, .end = i + 1 == n ? total_size : (i + 1) * size});
+  }
+  return segments;
+}
+
+inline void encode_segments(const std::vector<part_segment> &segments, std::string &states) {
+  part_hasher_state hs{.method = part_segments_method,
+                       .size = static_cast<uint32_t>(segments.size() * sizeof(part_segment))};
+  states.append(reinterpret_cast<const char *>(&hs), sizeof(hs));
+  states.append(reinterpret_cast<const char *>(segments.data()), hs.size);
+}
+
+// decode_segments finds the segment table among the states saved with a part
+inline bool decode_segments(std::string_view states, std::vector<part_segment> &segments) {
+  while (states.size() >= sizeof(part_hasher_state)) {
+    part_hasher_state hs;
+    memcpy(&hs, states.data(), sizeof(hs));
+    states.remove_prefix(sizeof(hs));
+    if (states.size() < hs.size) {
+      return false;
+    }
+    if (hs.method == part_segments_method && hs.size % sizeof(part_segment) == 0) {
+      segments.resize(hs.size / sizeof(part_segment));
+      memcpy(segments.data(), states.data(), hs.size);
+      return !segments.empty();
+    }
+    states.remove_prefix(hs.size);
+  }
+  return false;
+}
+
 struct HashPrefix {
   const std::wstring_view prefix;
   hash_t method;
@@ -53,6 +111,7 @@ constexpr HashPrefix hnmaps[] = {
     {L"SHA3-384", hash_t::SHA3_384, 48}, // SHA3-384
     {L"SHA3-512", hash_t::SHA3_512, 64}, // SHA3-512
     {L"SHA3", hash_t::SHA3, 32},         // SHA3 alias for SHA3-256
+    {L"URL", hash_t::URL, 32},           // url_part_key
 };
 
 inline bool hash_construct(std::wstring_view hash_value, part_overlay_data &overlay_data, bela::error_code &ec) {
@@ -85,6 +144,16 @@ inline bool hash_construct(std::wstring_view hash_value, part_overlay_data &over
   return true;
 }
 
+// url_part_key keys the part of a segmented download that has no hash value, the part is resumed only when the
+// server reports the same size again
+inline std::wstring url_part_key(std::wstring_view url) {
+  bela::hash::sha256::Hasher h;
+  h.Initialize();
+  auto u8 = bela::encode_into<wchar_t, char>(url);
+  h.Update(u8.data(), u8.size());
+  return bela::StringCat(L"URL:", h.Finalize());
+}
+
 struct _File_disposition_info_ex {
   DWORD _Flags;
 };
@@ -141,8 +210,9 @@ inline bool truncated_file(HANDLE fd, int64_t pos, bela::error_code &ec) {
 class FilePart {
 public:
   FilePart(HANDLE fd_, const std::filesystem::path &fsPath_, int64_t total_bytes_, int64_t current_bytes_,
-           int64_t recent_)
-      : fd(fd_), fsPath(fsPath_), total_bytes(total_bytes_), current_bytes(current_bytes_), laste_time(recent_) {}
+           int64_t recent_, std::string &&states_ = {})
+      : fd(fd_), fsPath(fsPath_), total_bytes(total_bytes_), current_bytes(current_bytes_), laste_time(recent_),
+        states(std::move(states_)) {}
   FilePart(const FilePart &) = delete;
   FilePart &operator=(const FilePart &) = delete;
   ~FilePart() noexcept { file_discard(); }
@@ -158,7 +228,57 @@ public:
     total_bytes = 0;
     return true;
   }
-  bool SaveOverlayData(std::wstring_view hash_value, int64_t total_bytes, int64_t current_bytes, bela::error_code &ec) {
+  // Preallocate sizes the part for a segmented download, every segment is written at its own offset
+  bool Preallocate(int64_t size, bela::error_code &ec) {
+    if (!truncated_file(fd, size, ec)) {
+      return false;
+    }
+    total_bytes = size;
+    current_bytes = size;
+    return true;
+  }
+  // WriteAt writes at pos without moving the file pointer, segments call it from their own threads
+  bool WriteAt(const void *data, size_t bytes, int64_t pos, bela::error_code &ec) {
+    auto u8d = reinterpret_cast<const uint8_t *>(data);
+    while (bytes > 0) {
+      OVERLAPPED o{};
+      o.Offset = static_cast<DWORD>(pos);
+      o.OffsetHigh = static_cast<DWORD>(pos >> 32);
+      DWORD dwSize = 0;
+      if (WriteFile(fd, u8d, static_cast<DWORD>((std::min)(bytes, size_t{1} << 30)), &dwSize, &o) != TRUE) {
+        ec = bela::make_system_error_code(L"WriteFile() ");
+        return false;
+      }
+      u8d += dwSize;
+      pos += dwSize;
+      bytes -= dwSize;
+    }
+    return true;
+  }
+  // States returns the hasher states saved with the part, empty when the part is new
+  std::string_view States() const { return states; }
+  // ReadPart feeds the bytes already downloaded to fn, hashers without a saved state catch up this way
+  template <typename Fn> bool ReadPart(Fn &&fn, bela::error_code &ec) {
+    std::vector<uint8_t> buffer(256 * 1024);
+    int64_t pos = 0;
+    while (pos < current_bytes) {
+      auto len = (std::min)(buffer.size(), static_cast<size_t>(current_bytes - pos));
+      size_t outSize = 0;
+      if (!bela::io::ReadAt(fd, buffer.data(), len, pos, outSize, ec)) {
+        return false;
+      }
+      if (outSize == 0) {
+        ec = bela::make_error_code(L"FilePart shorter than current_bytes");
+        return false;
+      }
+      fn(buffer.data(), outSize);
+      pos += static_cast<int64_t>(outSize);
+    }
+    // ReadAt moved the file pointer, new data is appended at the end of the part
+    return bela::io::Seek(fd, current_bytes, ec);
+  }
+  bool SaveOverlayData(std::wstring_view hash_value, int64_t total_bytes, int64_t current_bytes,
+                       std::string_view hasher_states, bela::error_code &ec) {
     if (!discard_file_handle) {
       ec = bela::make_error_code(L"FilePart not a discard file");
       return false;
@@ -169,13 +289,14 @@ public:
     }
     auto now = bela::Now();
     part_overlay_data overlay_data{
-        .magic = {'P', 'A', 'R', 'T'},
+        .magic = {part_magic[0], part_magic[1], part_magic[2], part_magic[3]},
         .method = hash_t::NONE,
         .hashsz = {0},
         .hash = {0},
         .total_bytes = total_bytes,
         .current_bytes = current_bytes,
         .laste_time = bela::ToUnixSeconds(now),
+        .state_bytes = static_cast<uint32_t>(hasher_states.size()),
     };
     if (!hash_construct(hash_value, overlay_data, ec)) {
       return false;
@@ -187,6 +308,9 @@ public:
     if (!bela::io::Seek(fd, current_bytes, ec)) {
       return false;
     }
+    if (!WriteFull(hasher_states.data(), hasher_states.size(), ec)) {
+      return false;
+    }
     if (!WriteFull(overlay_data, ec)) {
       return false;
     }
@@ -274,6 +398,7 @@ public:
         .total_bytes = 0,
         .current_bytes = 0,
         .laste_time = 0,
+        .state_bytes = 0,
     };
     if (!hash_construct(hash_value, overlayInput, ec)) {
       if (!local_truncated()) {
@@ -290,6 +415,7 @@ public:
         .total_bytes = 0,
         .current_bytes = 0,
         .laste_time = 0,
+        .state_bytes = 0,
     };
     size_t outSize = 0;
     if (!bela::io::ReadAt(fd, &overlayDisk, sizeof(overlayDisk), seekTo, outSize, ec)) {
@@ -305,12 +431,28 @@ public:
       }
       return std::make_optional<FilePart>(fd, fsPath, 0, 0, 0);
     }
-    if (!truncated_file(fd, seekTo, ec)) {
+    std::string hasher_states;
+    if (overlayDisk.current_bytes < 0 || overlayDisk.current_bytes + overlayDisk.state_bytes != seekTo) {
+      if (!local_truncated()) {
+        return std::nullopt;
+      }
+      return std::make_optional<FilePart>(fd, fsPath, 0, 0, 0);
+    }
+    if (overlayDisk.state_bytes != 0) {
+      hasher_states.resize(overlayDisk.state_bytes);
+      if (!bela::io::ReadAt(fd, hasher_states.data(), hasher_states.size(), overlayDisk.current_bytes, outSize, ec) ||
+          outSize != hasher_states.size()) {
+        // the states are an optimization, the part is hashed again instead
+        hasher_states.clear();
+        ec.clear();
+      }
+    }
+    if (!truncated_file(fd, overlayDisk.current_bytes, ec)) {
       return std::nullopt;
     }
     // current_bytes part found
     return std::make_optional<FilePart>(fd, fsPath, overlayDisk.total_bytes, overlayDisk.current_bytes,
-                                        overlayDisk.laste_time);
+                                        overlayDisk.laste_time, std::move(hasher_states));
   }
 
 private:
@@ -319,6 +461,7 @@ private:
   int64_t total_bytes{0};
   int64_t current_bytes{0};
   int64_t laste_time{0};
+  std::string states;
   bool discard_file_handle{true};
   void file_discard() noexcept {
     if (fd != INVALID_HANDLE_VALUE) {
@@ -6,6 +6,8 @@
 #include <schannel.h>
 #include <ws2tcpip.h>
 #include <winhttp.h>
+#include <chrono>
+#include <mutex>
 
 struct WINHTTP_SECURITY_INFO_X {
   SecPkgContext_ConnectionInfo ConnectionInfo;
@@ -190,6 +192,7 @@ class handle {
 public:
   handle() = default;
   handle(HINTERNET h_) : h(h_) {}
+  handle(handle &&o) noexcept : h(std::exchange(o.h, nullptr)) {}
   handle(const handle &) = delete;
   handle &operator=(const handle &) = delete;
   ~handle() {
@@ -229,28 +232,14 @@ public:
   // fill header
   bool write_headers(const headers_t &hkv, const std::vector<std::wstring> &cookies, int64_t position, int64_t length,
                      bela::error_code &ec) {
-    std::wstring flattened_headers;
-    for (const auto &[key, value] : hkv) {
-      bela::StrAppend(&flattened_headers, key, L": ", value, L"\r\n");
-    }
     // part download
-    if (position > 0) {
-      // https://developer.mozilla.org/zh-CN/docs/Web/HTTP/Headers/Range
-      bela::StrAppend(&flattened_headers, L"Range: bytes=", position, L"-");
-    }
-    if (!cookies.empty()) {
-      bela::StrAppend(&flattened_headers, L"Cookie: ", bela::StrJoin(cookies, L"; "), L"\r\n");
-    }
-
-    if (flattened_headers.empty()) {
-      return true;
-    }
-    if (WinHttpAddRequestHeaders(h, flattened_headers.data(), static_cast<DWORD>(flattened_headers.size()),
-                                 WINHTTP_ADDREQ_FLAG_ADD) != TRUE) {
-      ec = make_net_error_code();
-      return false;
-    }
-    return true;
+    // https://developer.mozilla.org/zh-CN/docs/Web/HTTP/Headers/Range
+    return add_headers(hkv, cookies, position > 0 ? bela::StringCat(L"bytes=", position, L"-") : std::wstring(), ec);
+  }
+  // write_range_headers requests bytes [first, last] of the resource
+  bool write_range_headers(const headers_t &hkv, const std::vector<std::wstring> &cookies, int64_t first, int64_t last,
+                           bela::error_code &ec) {
+    return add_headers(hkv, cookies, bela::StringCat(L"bytes=", first, L"-", last), ec);
   }
   bool write_body(std::wstring_view body, std::wstring_view content_type, WINHTTP_STATUS_CALLBACK callback,
                   DWORD_PTR dwContext, bela::error_code &ec) {
@@ -416,6 +405,29 @@ public:
 private:
   friend std::optional<handle> make_session(std::wstring_view ua, bela::error_code &ec);
   HINTERNET h{nullptr};
+  bool add_headers(const headers_t &hkv, const std::vector<std::wstring> &cookies, std::wstring_view range,
+                   bela::error_code &ec) {
+    std::wstring flattened_headers;
+    for (const auto &[key, value] : hkv) {
+      bela::StrAppend(&flattened_headers, key, L": ", value, L"\r\n");
+    }
+    if (!range.empty()) {
+      bela::StrAppend(&flattened_headers, L"Range: ", range, L"\r\n");
+    }
+    if (!cookies.empty()) {
+      bela::StrAppend(&flattened_headers, L"Cookie: ", bela::StrJoin(cookies, L"; "), L"\r\n");
+    }
+
+    if (flattened_headers.empty()) {
+      return true;
+    }
+    if (WinHttpAddRequestHeaders(h, flattened_headers.data(), static_cast<DWORD>(flattened_headers.size()),
+                                 WINHTTP_ADDREQ_FLAG_ADD) != TRUE) {
+      ec = make_net_error_code();
+      return false;
+    }
+    return true;
+  }
 };
 
 // make a session handle
@@ -429,6 +441,69 @@ inline std::optional<handle> make_session(std::wstring_view ua, bela::error_code
   return std::make_optional<handle>(hSession);
 }
 
+// session_pool keeps a session and its connection per host, port, proxy and user agent. WinHTTP keeps the sockets of a
+// session alive once a response is read completely, so later requests to the same host skip DNS, TCP and TLS setup
+class session_pool {
+public:
+  struct connection {
+    handle session;
+    handle conn;
+    std::chrono::steady_clock::time_point used;
+  };
+  // sessions left unused longer than this are closed by the next acquire
+  static constexpr auto idle_timeout = std::chrono::seconds(90);
+  session_pool() = default;
+  session_pool(const session_pool &) = delete;
+  session_pool &operator=(const session_pool &) = delete;
+  std::shared_ptr<connection> acquire(const url &u, std::wstring_view ua, std::wstring_view proxy, bool &reused,
+                                      bela::error_code &ec) {
+    auto key = bela::StringCat(bela::AsciiStrToLower(u.host), L":", u.nPort, L"|", proxy, L"|", ua);
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mtx);
+    // connections still held by a request are never evicted
+    for (auto it = connections.begin(); it != connections.end();) {
+      if (it->first != key && it->second.use_count() == 1 && now - it->second->used > idle_timeout) {
+        connections.erase(it++);
+        continue;
+      }
+      ++it;
+    }
+    if (auto it = connections.find(key); it != connections.end()) {
+      if (it->second.use_count() > 1 || now - it->second->used <= idle_timeout) {
+        it->second->used = now;
+        reused = true;
+        return it->second;
+      }
+      connections.erase(it);
+    }
+    reused = false;
+    auto session = make_session(ua, ec);
+    if (!session) {
+      return nullptr;
+    }
+    if (!proxy.empty()) {
+      std::wstring proxyURL(proxy);
+      session->set_proxy_url(proxyURL);
+    }
+    session->protocol_enable();
+    auto conn = session->connect(u.host, u.nPort, ec);
+    if (!conn) {
+      return nullptr;
+    }
+    auto c = std::make_shared<connection>(std::move(*session), std::move(*conn), now);
+    connections.emplace(std::move(key), c);
+    return c;
+  }
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return connections.size();
+  }
+
+private:
+  std::mutex mtx;
+  bela::flat_hash_map<std::wstring, std::shared_ptr<connection>> connections;
+};
+
 } // namespace baulk::net::native
 
 #endif
\ No newline at end of file
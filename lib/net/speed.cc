@@ -1,25 +1,179 @@
 //
 #include <baulk/net.hpp>
 #include <baulk/net/tcp.hpp>
+#include <baulk/json_utils.hpp>
 #include "native.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 namespace baulk::net {
 constexpr auto MaximumTime = (std::numeric_limits<std::uint64_t>::max)();
 
-std::uint64_t UrlResponseTime(std::wstring_view url) {
+// mirror_cache remembers how long connecting to each mirror host took, BestUrl skips probing while every mirror of a
+// package has a fresh entry. The entries are kept in a json file so that the next baulk run can reuse them
+class mirror_cache {
+public:
+  static mirror_cache &Instance() {
+    static mirror_cache cache;
+    return cache;
+  }
+  void Initialize(std::wstring_view file_, std::chrono::seconds ttl_) {
+    std::lock_guard<std::mutex> lock(mtx);
+    file = file_;
+    ttl = ttl_;
+    entries.clear();
+    if (file.empty() || ttl.count() <= 0) {
+      return;
+    }
+    bela::error_code ec;
+    auto jo = parse_json_file(file, ec);
+    if (!jo || !jo->obj.is_object()) {
+      return;
+    }
+    try {
+      for (const auto &[k, v] : jo->obj.items()) {
+        auto e = entry{.elapsed = v.value("elapsed", MaximumTime),
+                       .measured = std::chrono::system_clock::time_point(
+                           std::chrono::seconds(v.value("measured", static_cast<int64_t>(0))))};
+        if (fresh(e)) {
+          entries.insert_or_assign(bela::encode_into<char, wchar_t>(k), e);
+        }
+      }
+    } catch (const std::exception &e) {
+      HttpClient::DefaultClient().DbgPrint(L"baulk: unable decode %s error: %s", file, e.what());
+    }
+  }
+  std::optional<std::uint64_t> Lookup(const std::wstring &key) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (auto it = entries.find(key); it != entries.end() && fresh(it->second)) {
+      return std::make_optional(it->second.elapsed);
+    }
+    return std::nullopt;
+  }
+  void Store(const std::vector<std::wstring> &keys, const std::vector<std::uint64_t> &times) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto now = std::chrono::system_clock::now();
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (!keys[i].empty()) {
+        entries.insert_or_assign(keys[i], entry{.elapsed = times[i], .measured = now});
+      }
+    }
+    save();
+  }
+
+private:
+  struct entry {
+    std::uint64_t elapsed{MaximumTime};
+    std::chrono::system_clock::time_point measured;
+  };
+  std::mutex mtx;
+  bela::flat_hash_map<std::wstring, entry> entries;
+  std::wstring file;
+  std::chrono::seconds ttl{600};
+  bool fresh(const entry &e) const {
+    auto age = std::chrono::system_clock::now() - e.measured;
+    return age >= std::chrono::system_clock::duration::zero() && age < ttl;
+  }
+  void save() {
+    if (file.empty() || ttl.count() <= 0) {
+      return;
+    }
+    try {
+      auto obj = nlohmann::json::object();
+      for (const auto &[k, e] : entries) {
+        if (fresh(e)) {
+          obj[bela::encode_into<wchar_t, char>(k)] = nlohmann::json{
+              {"elapsed", e.elapsed},
+              {"measured", std::chrono::duration_cast<std::chrono::seconds>(e.measured.time_since_epoch()).count()}};
+        }
+      }
+      bela::error_code ec;
+      if (!bela::io::AtomicWriteText(file, bela::io::as_bytes<char>(obj.dump(4)), ec)) {
+        HttpClient::DefaultClient().DbgPrint(L"baulk: unable save %s error: %s", file, ec);
+      }
+    } catch (const std::exception &e) {
+      HttpClient::DefaultClient().DbgPrint(L"baulk: unable encode %s error: %s", file, e.what());
+    }
+  }
+};
+
+inline std::wstring mirror_key(std::wstring_view url) {
   bela::error_code ec;
-  auto u = native::crack_url(url, ec);
-  if (!u) {
-    return MaximumTime;
+  if (auto u = native::crack_url(url, ec); u) {
+    return bela::StringCat(bela::AsciiStrToLower(u->host), L":", u->nPort);
   }
+  return L"";
+}
+
+// race_state is shared by RaceMirrors and its probes, a probe still resolving the host name when the winner is known
+// keeps it alive after RaceMirrors returned
+struct race_state {
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::atomic_bool settled{false};
+  size_t winner{0};
+  size_t pending{0};
+  std::vector<std::uint64_t> times;
+  std::vector<bool> finished;
+};
+
+// RaceMirrors dials every mirror at once and returns the first one connected, the other dials are canceled and not
+// waited for: ResolveName cannot be canceled. A mirror that failed is cached as unreachable, a canceled one with the
+// time it had already waited
+size_t RaceMirrors(const std::vector<std::wstring> &urls, const std::vector<std::wstring> &keys) {
+  auto state = std::make_shared<race_state>();
+  state->pending = urls.size();
+  state->times.assign(urls.size(), MaximumTime);
+  state->finished.assign(urls.size(), false);
   auto begin = std::chrono::steady_clock::now();
-  if (auto conn = baulk::net::DialTimeout(u->host, u->nPort, 10000, ec); !conn) {
-    return MaximumTime;
+  auto since = [begin] {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+  };
+  for (size_t i = 0; i < urls.size(); i++) {
+    std::thread([state, since, i, url = urls[i]] {
+      bela::error_code ec;
+      std::optional<Conn> conn;
+      if (auto u = native::crack_url(url, ec); u) {
+        conn = baulk::net::DialTimeout(u->host, u->nPort, 10000, state->settled, ec);
+      }
+      auto elapsed = since();
+      std::lock_guard<std::mutex> lock(state->mtx);
+      if (conn && !state->settled) {
+        state->settled = true;
+        state->winner = i;
+      }
+      if (conn || state->settled) {
+        state->times[i] = elapsed;
+      }
+      state->finished[i] = true;
+      state->pending--;
+      state->cv.notify_one();
+    }).detach();
+  }
+  std::vector<std::uint64_t> times;
+  size_t winner = 0;
+  {
+    std::unique_lock<std::mutex> lock(state->mtx);
+    state->cv.wait(lock, [&] { return state->settled || state->pending == 0; });
+    state->settled = true;
+    auto elapsed = since();
+    for (size_t i = 0; i < urls.size(); i++) {
+      if (!state->finished[i]) {
+        state->times[i] = elapsed;
+      }
+    }
+    times = state->times;
+    winner = state->winner;
   }
-  auto cur = std::chrono::steady_clock::now();
-  return std::chrono::duration_cast<std::chrono::nanoseconds>(cur - begin).count();
+  mirror_cache::Instance().Store(keys, times);
+  return winner;
 }
 
+void SetMirrorCache(std::wstring_view file, std::chrono::seconds ttl) { mirror_cache::Instance().Initialize(file, ttl); }
+
 std::wstring_view BestUrlInternal(const std::vector<std::wstring> &urls, std::wstring_view locale) {
   if (urls.empty()) {
     return L"";
@@ -27,8 +181,6 @@ std::wstring_view BestUrlInternal(const std::vector<std::wstring> &urls, std::ws
   if (urls.size() == 1) {
     return urls[0];
   }
-  auto elapsed = MaximumTime;
-  size_t pos = 0;
   auto suffix = bela::StringCat(L"#", locale);
   // The first round to determine whether there is a mirror image of the area
   for (const auto &u : urls) {
@@ -39,15 +191,27 @@ std::wstring_view BestUrlInternal(const std::vector<std::wstring> &urls, std::ws
       return url;
     }
   }
-  // Second round of analysis of network connection establishment time
+  // Second round of analysis of network connection establishment time, cached times are used when all are fresh
+  std::vector<std::wstring> keys;
+  auto elapsed = MaximumTime;
+  size_t pos = 0;
+  bool cached = true;
   for (size_t i = 0; i < urls.size(); i++) {
-    // connect url to get elapsed timeout
-    auto resptime = UrlResponseTime(urls[i]);
-    if (resptime < elapsed) {
+    keys.emplace_back(mirror_key(urls[i]));
+    auto t = mirror_cache::Instance().Lookup(keys.back());
+    if (!t) {
+      cached = false;
+      continue;
+    }
+    if (*t < elapsed) {
+      elapsed = *t;
       pos = i;
     }
   }
-  return urls[pos];
+  if (cached) {
+    return urls[pos];
+  }
+  return urls[RaceMirrors(urls, keys)];
 }
 
 std::wstring_view BestUrl(const std::vector<std::wstring> &urls, std::wstring_view locale) {
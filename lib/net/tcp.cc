@@ -154,7 +154,8 @@ ssize_t Conn::ReadTimeout(char *buf, size_t len, int timeout) {
   return -1;
 }
 
-bool DialTimeoutInternal(BAULKSOCK sock, const ADDRINFOEX4 *hi, int timeout, bela::error_code &ec) {
+bool DialTimeoutInternal(BAULKSOCK sock, const ADDRINFOEX4 *hi, int timeout, const std::atomic_bool *canceled,
+                         bela::error_code &ec) {
   ULONG flags = 1;
   if (ioctlsocket(sock, FIONBIO, &flags) == SOCKET_ERROR) {
     ec = make_wsa_error_code(WSAGetLastError(), L"ioctlsocket() ");
@@ -168,22 +169,42 @@ bool DialTimeoutInternal(BAULKSOCK sock, const ADDRINFOEX4 *hi, int timeout, bel
     ec = make_wsa_error_code(rv, L"connect() ");
     return false;
   }
-  WSAPOLLFD pfd;
-  pfd.fd = sock;
-  pfd.events = POLLOUT;
-  auto rc = WSAPoll(&pfd, 1, timeout);
-  if (rc == 0) {
-    // timeout error DialTimeout make it
-    return false;
-  }
-  if (rc < 0) {
-    ec = make_wsa_error_code(WSAGetLastError(), L"connect() ");
-    return false;
+  // a cancelable dial polls in short slices so that it returns soon after being canceled
+  constexpr int slice = 50;
+  for (int waited = 0; waited < timeout; waited += slice) {
+    if (canceled != nullptr && canceled->load()) {
+      ec = bela::make_error_code(bela::ErrCanceled, L"connect() canceled");
+      return false;
+    }
+    WSAPOLLFD pfd;
+    pfd.fd = sock;
+    pfd.events = POLLOUT;
+    auto rc = WSAPoll(&pfd, 1, canceled == nullptr ? timeout : (std::min)(slice, timeout - waited));
+    if (rc < 0) {
+      ec = make_wsa_error_code(WSAGetLastError(), L"connect() ");
+      return false;
+    }
+    if (rc > 0) {
+      // a refused connection is reported as POLLERR/POLLHUP, it must not count as connected
+      if ((pfd.revents & (POLLERR | POLLHUP)) != 0) {
+        int error = 0;
+        int len = sizeof(error);
+        getsockopt(sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&error), &len);
+        ec = make_wsa_error_code(error != 0 ? error : WSAECONNREFUSED, L"connect() ");
+        return false;
+      }
+      return true;
+    }
+    if (canceled == nullptr) {
+      break;
+    }
   }
-  return true;
+  // timeout error DialTimeout make it
+  return false;
 }
 
-std::optional<Conn> DialTimeout(std::wstring_view address, int port, int timeout, bela::error_code &ec) {
+std::optional<Conn> DialTimeoutInternal(std::wstring_view address, int port, int timeout,
+                                        const std::atomic_bool *canceled, bela::error_code &ec) {
   static winsock_initializer initializer_;
   PADDRINFOEX4 rhints = nullptr;
   if (!ResolveName(address, port, &rhints, ec)) {
@@ -198,7 +219,7 @@ std::optional<Conn> DialTimeout(std::wstring_view address, int port, int timeout
       ec = make_wsa_error_code(WSAGetLastError(), L"socket() ");
       continue;
     }
-    if (DialTimeoutInternal(sock, hi, timeout, ec)) {
+    if (DialTimeoutInternal(sock, hi, timeout, canceled, ec)) {
       break;
     }
     closesocket(sock);
@@ -215,4 +236,13 @@ std::optional<Conn> DialTimeout(std::wstring_view address, int port, int timeout
   FreeAddrInfoExW(reinterpret_cast<ADDRINFOEXW *>(rhints)); /// Release
   return std::make_optional<baulk::net::Conn>(sock);
 }
+
+std::optional<Conn> DialTimeout(std::wstring_view address, int port, int timeout, bela::error_code &ec) {
+  return DialTimeoutInternal(address, port, timeout, nullptr, ec);
+}
+
+std::optional<Conn> DialTimeout(std::wstring_view address, int port, int timeout, const std::atomic_bool &canceled,
+                                bela::error_code &ec) {
+  return DialTimeoutInternal(address, port, timeout, &canceled, ec);
+}
 } // namespace baulk::net
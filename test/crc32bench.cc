@@ -0,0 +1,36 @@
+// crc32 micro-benchmark: table driven slicing-by-16 against the hardware dispatch used by Summator
+#include <baulk/archive/crc32.hpp>
+#include <bela/terminal.hpp>
+#include <chrono>
+#include <random>
+#include <vector>
+
+template <typename Fn> double Throughput(const std::vector<uint8_t> &buffer, Fn fn, uint32_t &crc) {
+  constexpr int rounds = 8;
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++) {
+    crc = fn(buffer.data(), buffer.size(), 0);
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+  return static_cast<double>(buffer.size()) * rounds / elapsed.count() / 1e9;
+}
+
+int wmain() {
+  std::vector<uint8_t> buffer(256 * 1024 * 1024);
+  std::mt19937_64 engine(20221016);
+  for (auto &b : buffer) {
+    b = static_cast<uint8_t>(engine());
+  }
+  uint32_t tableCrc = 0;
+  uint32_t fastCrc = 0;
+  auto table = Throughput(buffer, crc32_16bytes, tableCrc);
+  auto fast = Throughput(buffer, crc32_fast, fastCrc);
+  bela::FPrintF(stderr, L"hardware crc32: %v\n", crc32_hardware_available());
+  bela::FPrintF(stderr, L"slicing-by-16: %.2f GB/s crc32 %08x\n", table, tableCrc);
+  bela::FPrintF(stderr, L"crc32_fast:    %.2f GB/s crc32 %08x (%.2fx)\n", fast, fastCrc, fast / table);
+  if (tableCrc != fastCrc) {
+    bela::FPrintF(stderr, L"\x1b[31mcrc32 mismatch\x1b[0m\n");
+    return 1;
+  }
+  return 0;
+}
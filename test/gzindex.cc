@@ -0,0 +1,167 @@
+// gzip checkpoint index round trip: build the index while streaming a .gz, save it, load it back and check that
+// Discard seeking through the loaded checkpoints lands on the same bytes as inflating from the start
+#include <baulk/archive.hpp>
+#include <baulk/archive/tar.hpp>
+#include <bela/terminal.hpp>
+#include <zlib.h>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+using baulk::archive::file_format_t;
+using baulk::archive::tar::GzipIndex;
+
+// text with runs of random bytes: deflate emits many blocks and the windows are not trivial
+std::string MakePlain(size_t size) {
+  constexpr std::string_view words[] = {"alpha ", "beta ", "gamma ", "delta\n", "epsilon ", "zeta ", "eta ", "theta\n"};
+  std::mt19937 engine(20221016);
+  std::string plain;
+  while (plain.size() < size) {
+    auto v = engine();
+    if (v % 5 == 0) {
+      for (int i = 0; i < 8; i++) {
+        plain.push_back(static_cast<char>(engine()));
+      }
+      continue;
+    }
+    plain.append(words[v % std::size(words)]);
+  }
+  return plain;
+}
+
+bool WriteGzip(const std::filesystem::path &file, const std::string &plain, bela::error_code &ec) {
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  if (deflateInit2(&zs, 6, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"deflateInit2 failed");
+    return false;
+  }
+  std::vector<uint8_t> compressed(deflateBound(&zs, static_cast<uLong>(plain.size())));
+  zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(plain.data()));
+  zs.avail_in = static_cast<uInt>(plain.size());
+  zs.next_out = compressed.data();
+  zs.avail_out = static_cast<uInt>(compressed.size());
+  auto ret = deflate(&zs, Z_FINISH);
+  compressed.resize(zs.total_out);
+  deflateEnd(&zs);
+  if (ret != Z_STREAM_END) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"deflate failed");
+    return false;
+  }
+  return bela::io::AtomicWriteText(file.native(), compressed, ec);
+}
+
+// Probe opens file with index attached, skips target bytes and reads len bytes. len 0 reads to the end of the stream,
+// which completes an index that is being recorded
+bool Probe(const std::filesystem::path &file, GzipIndex &index, int64_t target, size_t len, std::string &got,
+           bela::error_code &ec) {
+  int64_t offset = 0;
+  file_format_t afmt{file_format_t::none};
+  auto fd = baulk::archive::OpenFile(file.native(), offset, afmt, ec);
+  if (!fd) {
+    return false;
+  }
+  baulk::archive::tar::FileReader fr(fd->NativeFD());
+  auto r = baulk::archive::tar::MakeReader(fr, offset, afmt, baulk::archive::DecoderOptions{}, &index, ec);
+  if (!r) {
+    return false;
+  }
+  if (target != 0 && !r->Discard(target, ec)) {
+    return false;
+  }
+  if (len == 0) {
+    got.clear();
+    ec.clear();
+    char buffer[8192];
+    for (;;) {
+      auto n = r->Read(buffer, sizeof(buffer), ec);
+      if (n <= 0) {
+        return !ec;
+      }
+      got.append(buffer, static_cast<size_t>(n));
+    }
+  }
+  got.resize(len);
+  size_t pos = 0;
+  while (pos < len) {
+    auto n = r->Read(got.data() + pos, len - pos, ec);
+    if (n <= 0) {
+      return false;
+    }
+    pos += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+int wmain() {
+  auto dir = std::filesystem::temp_directory_path() / L"baulk-gzindex-test";
+  std::error_code e;
+  std::filesystem::create_directories(dir, e);
+  auto file = dir / L"plain.gz";
+  auto indexFile = dir / L"plain.gz.gzi";
+  auto plain = MakePlain(12 * 1024 * 1024);
+  bela::error_code ec;
+  if (!WriteGzip(file, plain, ec)) {
+    bela::FPrintF(stderr, L"write %v error: %v\n", file, ec);
+    return 1;
+  }
+  auto archiveSize = static_cast<int64_t>(std::filesystem::file_size(file, e));
+  // build: one linear pass records a checkpoint about every 256K
+  GzipIndex built(256 * 1024);
+  std::string got;
+  if (!Probe(file, built, 0, 0, got, ec) || got != plain) {
+    bela::FPrintF(stderr, L"linear read error: %v\n", ec);
+    return 1;
+  }
+  if (!built.Complete()) {
+    bela::FPrintF(stderr, L"index not complete after a full read\n");
+    return 1;
+  }
+  if (!built.Save(indexFile, archiveSize, ec)) {
+    bela::FPrintF(stderr, L"save %v error: %v\n", indexFile, ec);
+    return 1;
+  }
+  GzipIndex loaded;
+  if (!loaded.Load(indexFile, archiveSize, ec)) {
+    bela::FPrintF(stderr, L"load %v error: %v\n", indexFile, ec);
+    return 1;
+  }
+  if (GzipIndex other; other.Load(indexFile, archiveSize + 1, ec)) {
+    bela::FPrintF(stderr, L"index loaded for another archive size\n");
+    return 1;
+  }
+  const auto &cps = loaded.Checkpoints();
+  if (!loaded.Complete() || cps.size() != built.Checkpoints().size() || cps.size() < 8) {
+    bela::FPrintF(stderr, L"loaded %d checkpoints, built %d\n", cps.size(), built.Checkpoints().size());
+    return 1;
+  }
+  // seek: targets on, just before and just after every checkpoint plus random offsets
+  std::vector<int64_t> targets;
+  for (const auto &cp : cps) {
+    for (auto target : {cp.out - 1, cp.out, cp.out + 1}) {
+      if (target + 4096 <= static_cast<int64_t>(plain.size())) {
+        targets.emplace_back(target);
+      }
+    }
+  }
+  std::mt19937_64 engine(20221017);
+  for (int i = 0; i < 64; i++) {
+    targets.emplace_back(static_cast<int64_t>(engine() % (plain.size() - 4096)));
+  }
+  int failed = 0;
+  for (auto target : targets) {
+    if (!Probe(file, loaded, target, 4096, got, ec)) {
+      bela::FPrintF(stderr, L"seek %d error: %v\n", target, ec);
+      failed++;
+      continue;
+    }
+    if (plain.compare(static_cast<size_t>(target), got.size(), got) != 0) {
+      bela::FPrintF(stderr, L"seek %d: bytes differ\n", target);
+      failed++;
+    }
+  }
+  std::filesystem::remove_all(dir, e);
+  bela::FPrintF(stderr, L"%d checkpoints, %d seeks, %d failed\n", cps.size(), targets.size(), failed);
+  return failed == 0 ? 0 : 1;
+}
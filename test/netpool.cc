@@ -0,0 +1,120 @@
+// session pool test: a local HTTP/1.1 server counts the connections opened by repeated HttpClient requests
+#include <baulk/net/client.hpp>
+#include <bela/terminal.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+class LocalServer {
+public:
+  LocalServer() = default;
+  LocalServer(const LocalServer &) = delete;
+  LocalServer &operator=(const LocalServer &) = delete;
+  ~LocalServer() {
+    if (ls != INVALID_SOCKET) {
+      closesocket(ls);
+    }
+    if (acceptor.joinable()) {
+      acceptor.join();
+    }
+    for (auto &w : workers) {
+      w.join();
+    }
+  }
+  bool Listen() {
+    if (ls = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP); ls == INVALID_SOCKET) {
+      return false;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int len = sizeof(addr);
+    if (bind(ls, reinterpret_cast<sockaddr *>(&addr), len) != 0 || listen(ls, SOMAXCONN) != 0 ||
+        getsockname(ls, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+      return false;
+    }
+    port = ntohs(addr.sin_port);
+    acceptor = std::thread([this] {
+      for (;;) {
+        auto s = accept(ls, nullptr, nullptr);
+        if (s == INVALID_SOCKET) {
+          return;
+        }
+        connections++;
+        workers.emplace_back([this, s] { serve(s); });
+      }
+    });
+    return true;
+  }
+  int Port() const { return port; }
+  int Connections() const { return connections; }
+  int Requests() const { return requests; }
+
+private:
+  // serve answers every request of a keep-alive connection until the client closes it
+  void serve(SOCKET s) {
+    constexpr std::string_view response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 2\r\n"
+                                          "Connection: keep-alive\r\n\r\nok";
+    std::string buffer;
+    char chunk[4096];
+    for (;;) {
+      auto n = recv(s, chunk, sizeof(chunk), 0);
+      if (n <= 0) {
+        break;
+      }
+      buffer.append(chunk, static_cast<size_t>(n));
+      for (auto pos = buffer.find("\r\n\r\n"); pos != std::string::npos; pos = buffer.find("\r\n\r\n")) {
+        buffer.erase(0, pos + 4);
+        requests++;
+        send(s, response.data(), static_cast<int>(response.size()), 0);
+      }
+    }
+    closesocket(s);
+  }
+  SOCKET ls{INVALID_SOCKET};
+  int port{0};
+  std::atomic_int connections{0};
+  std::atomic_int requests{0};
+  std::thread acceptor;
+  std::vector<std::thread> workers;
+};
+
+int wmain() {
+  WSADATA wsaData;
+  if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+    return 1;
+  }
+  constexpr int rounds = 16;
+  int connections = 0;
+  int requests = 0;
+  {
+    LocalServer server;
+    if (!server.Listen()) {
+      bela::FPrintF(stderr, L"unable listen: %s\n", bela::make_system_error_code().message);
+      return 1;
+    }
+    auto url = bela::StringCat(L"http://127.0.0.1:", server.Port(), L"/manifest.json");
+    {
+      baulk::net::HttpClient client;
+      for (int i = 0; i < rounds; i++) {
+        bela::error_code ec;
+        auto resp = client.Get(url, ec);
+        if (!resp || resp->Content() != "ok") {
+          bela::FPrintF(stderr, L"request %d failed: %s\n", i, ec.message);
+          return 1;
+        }
+      }
+    }
+    connections = server.Connections();
+    requests = server.Requests();
+  }
+  WSACleanup();
+  bela::FPrintF(stderr, L"%d requests over %d connections\n", requests, connections);
+  if (connections != 1) {
+    bela::FPrintF(stderr, L"\x1b[31mconnections are not reused\x1b[0m\n");
+    return 1;
+  }
+  return 0;
+}
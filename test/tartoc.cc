@@ -0,0 +1,232 @@
+// tar table of contents round trip: extract a .tar.gz while recording the toc, save it, load it back and extract
+// selected members through TocReader with the loaded gzip checkpoints
+#include <baulk/archive.hpp>
+#include <baulk/archive/tar.hpp>
+#include <baulk/archive/extractor.hpp>
+#include <bela/terminal.hpp>
+#include <zlib.h>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+using baulk::archive::file_format_t;
+namespace tar = baulk::archive::tar;
+
+struct member {
+  std::string name;
+  char typeflag{tar::TypeReg};
+  std::string data;
+  int64_t offset{0};
+};
+
+// text with runs of random bytes: deflate emits many blocks and the windows are not trivial
+std::string MakePlain(size_t size, uint32_t seed) {
+  constexpr std::string_view words[] = {"alpha ", "beta ", "gamma ", "delta\n", "epsilon ", "zeta ", "eta ", "theta\n"};
+  std::mt19937 engine(seed);
+  std::string plain;
+  while (plain.size() < size) {
+    auto v = engine();
+    if (v % 5 == 0) {
+      for (int i = 0; i < 8; i++) {
+        plain.push_back(static_cast<char>(engine()));
+      }
+      continue;
+    }
+    plain.append(words[v % std::size(words)]);
+  }
+  plain.resize(size);
+  return plain;
+}
+
+// AppendMember writes a ustar header and the padded data of m, m.offset is set to the offset of the data
+void AppendMember(std::string &archive, member &m) {
+  tar::ustar_header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.name, m.name.data(), (std::min)(m.name.size(), sizeof(h.name)));
+  snprintf(h.mode, sizeof(h.mode), "%07o", m.typeflag == tar::TypeDir ? 0755 : 0644);
+  snprintf(h.uid, sizeof(h.uid), "%07o", 0);
+  snprintf(h.gid, sizeof(h.gid), "%07o", 0);
+  snprintf(h.size, sizeof(h.size), "%011llo", static_cast<unsigned long long>(m.data.size()));
+  snprintf(h.mtime, sizeof(h.mtime), "%011llo", 1665878400ull);
+  h.typeflag = m.typeflag;
+  memcpy(h.magic, "ustar", 6);
+  memcpy(h.version, "00", 2);
+  memset(h.chksum, ' ', sizeof(h.chksum));
+  unsigned sum = 0;
+  for (auto c : std::string_view(reinterpret_cast<const char *>(&h), sizeof(h))) {
+    sum += static_cast<uint8_t>(c);
+  }
+  snprintf(h.chksum, sizeof(h.chksum), "%06o", sum);
+  h.chksum[7] = ' ';
+  archive.append(reinterpret_cast<const char *>(&h), sizeof(h));
+  m.offset = static_cast<int64_t>(archive.size());
+  archive.append(m.data);
+  archive.append((512 - archive.size() % 512) % 512, '\0');
+}
+
+bool WriteGzip(const std::filesystem::path &file, const std::string &plain, bela::error_code &ec) {
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  if (deflateInit2(&zs, 6, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"deflateInit2 failed");
+    return false;
+  }
+  std::vector<uint8_t> compressed(deflateBound(&zs, static_cast<uLong>(plain.size())));
+  zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(plain.data()));
+  zs.avail_in = static_cast<uInt>(plain.size());
+  zs.next_out = compressed.data();
+  zs.avail_out = static_cast<uInt>(compressed.size());
+  auto ret = deflate(&zs, Z_FINISH);
+  compressed.resize(zs.total_out);
+  deflateEnd(&zs);
+  if (ret != Z_STREAM_END) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"deflate failed");
+    return false;
+  }
+  return bela::io::AtomicWriteText(file.native(), compressed, ec);
+}
+
+// Extract extracts file to dest, recording into record or, when toc is set, replaying the entries selector accepts
+bool Extract(const std::filesystem::path &file, const std::filesystem::path &dest, tar::Toc *record, tar::Toc *toc,
+             const tar::Filter &selector, bela::error_code &ec) {
+  int64_t offset = 0;
+  file_format_t afmt{file_format_t::none};
+  auto fd = baulk::archive::OpenFile(file.native(), offset, afmt, ec);
+  if (!fd) {
+    return false;
+  }
+  tar::FileReader fr(fd->NativeFD());
+  auto index = toc != nullptr ? &toc->Index() : &record->Index();
+  auto r = tar::MakeReader(fr, offset, afmt, baulk::archive::DecoderOptions{}, index, ec);
+  if (!r) {
+    return false;
+  }
+  tar::Extractor extractor(r.get(), baulk::archive::ExtractorOptions{});
+  if (!extractor.InitializeExtractor(dest, ec)) {
+    return false;
+  }
+  if (selector) {
+    extractor.Select(selector);
+  }
+  if (toc != nullptr) {
+    return extractor.ExtractToc(*toc, nullptr, nullptr, ec);
+  }
+  extractor.RecordToc(record);
+  return extractor.Extract(nullptr, nullptr, ec);
+}
+
+// Verify checks that the regular members accepted by want were extracted to dest and the others were not
+int Verify(const std::filesystem::path &dest, const std::vector<member> &members,
+           const std::function<bool(const member &)> &want) {
+  int failed = 0;
+  for (const auto &m : members) {
+    if (m.typeflag != tar::TypeReg) {
+      continue;
+    }
+    auto out = dest / bela::encode_into<char, wchar_t>(m.name);
+    std::error_code e;
+    if (!want(m)) {
+      if (std::filesystem::exists(out, e)) {
+        bela::FPrintF(stderr, L"%s: extracted but not selected\n", m.name);
+        failed++;
+      }
+      continue;
+    }
+    std::string got;
+    if (bela::error_code ec; !bela::io::ReadFile(out.native(), got, ec, 64 * 1024 * 1024)) {
+      bela::FPrintF(stderr, L"%s: read error: %v\n", m.name, ec);
+      failed++;
+      continue;
+    }
+    if (got != m.data) {
+      bela::FPrintF(stderr, L"%s: content differs\n", m.name);
+      failed++;
+    }
+  }
+  return failed;
+}
+
+int wmain() {
+  auto dir = std::filesystem::temp_directory_path() / L"baulk-tartoc-test";
+  std::error_code e;
+  std::filesystem::remove_all(dir, e);
+  std::filesystem::create_directories(dir, e);
+  auto file = dir / L"pkg.tar.gz";
+  auto tocFile = dir / L"pkg.tar.gz.toc";
+  // big.bin spans several 4M checkpoints, the members after it are reached by seeking
+  std::vector<member> members{
+      {.name = "pkg/", .typeflag = tar::TypeDir},
+      {.name = "pkg/a.txt", .data = "hello toc\n"},
+      {.name = "pkg/big.bin", .data = MakePlain(14 * 1024 * 1024, 20221016)},
+      {.name = "pkg/sub/", .typeflag = tar::TypeDir},
+      {.name = "pkg/sub/c.txt", .data = MakePlain(3000, 20221017)},
+      {.name = "pkg/sub/d.bin", .data = MakePlain(1024 * 1024 + 17, 20221018)},
+      {.name = "pkg/z.txt", .data = "last\n"},
+  };
+  std::string archive;
+  for (auto &m : members) {
+    AppendMember(archive, m);
+  }
+  archive.append(1024, '\0');
+  bela::error_code ec;
+  if (!WriteGzip(file, archive, ec)) {
+    bela::FPrintF(stderr, L"write %v error: %v\n", file, ec);
+    return 1;
+  }
+  // record: a full extraction fills the toc and the gzip checkpoints
+  tar::Toc built;
+  if (!Extract(file, dir / L"full", &built, nullptr, nullptr, ec)) {
+    bela::FPrintF(stderr, L"extract error: %v\n", ec);
+    return 1;
+  }
+  int failed = Verify(dir / L"full", members, [](const member &) { return true; });
+  if (!built.Save(tocFile, "1-1", ec)) {
+    bela::FPrintF(stderr, L"save %v error: %v\n", tocFile, ec);
+    return 1;
+  }
+  if (tar::Toc other; other.Load(tocFile, "1-2", ec)) {
+    bela::FPrintF(stderr, L"toc loaded with another key\n");
+    return 1;
+  }
+  tar::Toc loaded;
+  if (!loaded.Load(tocFile, "1-1", ec)) {
+    bela::FPrintF(stderr, L"load %v error: %v\n", tocFile, ec);
+    return 1;
+  }
+  const auto &entries = loaded.Entries();
+  if (entries.size() != members.size() || loaded.Index().Checkpoints().size() < 2) {
+    bela::FPrintF(stderr, L"loaded %d entries and %d checkpoints\n", entries.size(),
+                  loaded.Index().Checkpoints().size());
+    return 1;
+  }
+  for (size_t i = 0; i < entries.size(); i++) {
+    const auto &te = entries[i];
+    const auto &m = members[i];
+    if (te.name != m.name || te.typeflag != m.typeflag || te.offset != m.offset ||
+        te.size != static_cast<int64_t>(m.data.size())) {
+      bela::FPrintF(stderr, L"entry %d: %s at %d size %d, want %s at %d size %d\n", i, te.name, te.offset, te.size,
+                    m.name, m.offset, m.data.size());
+      failed++;
+    }
+  }
+  // replay: only the selected members are read, the data before them is skipped with the checkpoints
+  constexpr std::string_view prefixes[] = {"pkg/sub/", "pkg/z.txt", "pkg/a.txt"};
+  for (size_t i = 0; i < std::size(prefixes); i++) {
+    auto prefix = prefixes[i];
+    auto selected = [&](std::string_view name) { return name.starts_with(prefix); };
+    auto selector = [&](const tar::Header &h, const std::wstring &) { return selected(h.Name); };
+    auto dest = dir / bela::StringCat(L"select-", i);
+    if (!Extract(file, dest, nullptr, &loaded, selector, ec)) {
+      bela::FPrintF(stderr, L"extract %s error: %v\n", prefix, ec);
+      failed++;
+      continue;
+    }
+    failed += Verify(dest, members, [&](const member &m) { return selected(m.name); });
+  }
+  std::filesystem::remove_all(dir, e);
+  bela::FPrintF(stderr, L"%d entries, %d checkpoints, %d failed\n", entries.size(), loaded.Index().Checkpoints().size(),
+                failed);
+  return failed == 0 ? 0 : 1;
+}
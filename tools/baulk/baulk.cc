@@ -9,6 +9,7 @@ namespace baulk {
 bool IsDebugMode = false;
 bool IsForceMode = false;
 bool IsForceDelete = false;
+bool IsParanoidMode = false;
 bool IsQuietMode = false;
 bool IsTraceMode = false;
 
@@ -41,6 +42,7 @@ std::optional<command_t> ParseArgv(int argc, wchar_t **argv) {
       .Add(L"insecure", cli::no_argument, 'k')
       .Add(L"https-proxy", cli::required_argument, 1001) // option
       .Add(L"force-delete", cli::no_argument, 1002)
+      .Add(L"paranoid", cli::no_argument, 1003)
       .Add(L"trace", cli::no_argument, 'T')
       .Add(L"bucket");
 
@@ -85,6 +87,9 @@ std::optional<command_t> ParseArgv(int argc, wchar_t **argv) {
         case 1002:
           IsForceDelete = true;
           break;
+        case 1003:
+          IsParanoidMode = true;
+          break;
         default:
           return false;
         }
@@ -10,6 +10,7 @@
 namespace baulk {
 extern bool IsForceMode;
 extern bool IsForceDelete;
+extern bool IsParanoidMode;
 extern bool IsQuietMode;
 extern bool IsTraceMode;
 
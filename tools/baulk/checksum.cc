@@ -0,0 +1,203 @@
+//
+#include <bela/terminal.hpp>
+#include <bela/io.hpp>
+#include <bela/ascii.hpp>
+#include <bela/match.hpp>
+#include <bela/strip.hpp>
+#include <bela/str_split.hpp>
+#include <bela/numbers.hpp>
+#include <baulk/argv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "baulk.hpp"
+#include "checksum.hpp"
+
+namespace baulk {
+struct checksum_entry {
+  std::filesystem::path path;
+  // name is printed, it is relative to the directory holding the argument (or the checksum file)
+  std::wstring name;
+  std::wstring expected;
+  std::wstring digest;
+  bela::error_code ec;
+  bool hashed{false};
+  bool done{false};
+};
+
+// checksum_expand adds file, or every regular file below it when it is a directory, sorted by path
+bool checksum_expand(std::wstring_view file, std::vector<checksum_entry> &entries, bela::error_code &ec) {
+  std::error_code e;
+  auto root = std::filesystem::absolute(file, e).lexically_normal();
+  if (e) {
+    ec = bela::make_error_code_from_std(e, L"absolute() ");
+    return false;
+  }
+  if (!root.has_filename()) {
+    root = root.parent_path();
+  }
+  if (!std::filesystem::is_directory(root, e)) {
+    entries.emplace_back(checksum_entry{.path = root, .name = root.filename().native()});
+    return true;
+  }
+  std::vector<std::filesystem::path> files;
+  for (auto it = std::filesystem::recursive_directory_iterator(root, e); !e && it != std::end(it); it.increment(e)) {
+    if (it->is_regular_file(e)) {
+      files.emplace_back(it->path());
+    }
+  }
+  if (e) {
+    ec = bela::make_error_code_from_std(e, L"walk directory ");
+    return false;
+  }
+  std::sort(files.begin(), files.end());
+  auto base = root.parent_path();
+  for (auto &f : files) {
+    auto name = f.lexically_relative(base).native();
+    entries.emplace_back(checksum_entry{.path = std::move(f), .name = std::move(name)});
+  }
+  return true;
+}
+
+// checksum_parse reads the 'digest name' lines of a checksum file, 'digest *name' (binary mode) is accepted as well
+bool checksum_parse(std::wstring_view file, std::vector<checksum_entry> &entries, bela::error_code &ec) {
+  std::wstring text;
+  if (!bela::io::ReadFile(file, text, ec)) {
+    return false;
+  }
+  auto dir = std::filesystem::path(file).parent_path();
+  std::vector<std::wstring_view> lines = bela::StrSplit(text, bela::ByChar('\n'), bela::SkipEmpty());
+  for (auto line : lines) {
+    line = bela::StripTrailingAsciiWhitespace(line);
+    if (line.empty() || line.front() == '#') {
+      continue;
+    }
+    auto pos = line.find_first_of(L" \t");
+    if (pos == std::wstring_view::npos) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"improperly formatted checksum line '", line, L"'");
+      return false;
+    }
+    auto name = bela::StripLeadingAsciiWhitespace(line.substr(pos));
+    bela::ConsumePrefix(&name, L"*");
+    entries.emplace_back(
+        checksum_entry{.path = dir / name, .name = std::wstring(name), .expected = std::wstring(line.substr(0, pos))});
+  }
+  return true;
+}
+
+// checksum_run hashes the entries on up to jobs threads, report sees them in order as soon as each one is done. The
+// processors are shared between the workers, a worker hashing a large file does not start threads of its own when
+// every processor already runs a worker
+void checksum_run(std::vector<checksum_entry> &entries, hash::hash_t method, uint32_t jobs,
+                  const std::function<void(const checksum_entry &)> &report) {
+  auto n = (std::min)(static_cast<size_t>((std::max)(jobs, 1u)), entries.size());
+  auto processors = (std::max)(std::thread::hardware_concurrency(), 1u);
+  auto budget = (std::max)(processors / static_cast<uint32_t>((std::max)(n, size_t{1})), 1u);
+  std::atomic_size_t next{0};
+  std::mutex mtx;
+  std::condition_variable cv;
+  auto worker = [&]() {
+    for (;;) {
+      auto i = next++;
+      if (i >= entries.size()) {
+        return;
+      }
+      auto &e = entries[i];
+      if (auto hv = hash::FileHash(e.path, method, budget, e.ec); hv) {
+        e.digest = std::move(*hv);
+        e.hashed = true;
+      }
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        e.done = true;
+      }
+      cv.notify_all();
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < n; i++) {
+    workers.emplace_back(worker);
+  }
+  for (const auto &e : entries) {
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock, [&] { return e.done; });
+    }
+    report(e);
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+}
+
+int checksum_command(const std::vector<std::wstring_view> &argv, hash::hash_t method, std::wstring_view name,
+                     void (*usage)()) {
+  baulk::cli::ParseArgv pa(argv);
+  pa.Add(L"check", baulk::cli::no_argument, L'c').Add(L"jobs", baulk::cli::required_argument, L'j');
+  bool check{false};
+  uint32_t jobs = (std::max)(std::thread::hardware_concurrency(), 1u);
+  bela::error_code ec;
+  auto ret = pa.Execute(
+      [&](int val, const wchar_t *oa, const wchar_t *) {
+        switch (val) {
+        case L'c':
+          check = true;
+          break;
+        case L'j':
+          if (!bela::SimpleAtoi(oa, &jobs) || jobs == 0) {
+            ec = bela::make_error_code(bela::ErrGeneral, L"unable parse jobs: ", oa);
+            return false;
+          }
+          break;
+        default:
+          break;
+        }
+        return true;
+      },
+      ec);
+  if (!ret) {
+    bela::FPrintF(stderr, L"baulk: parse argv error \x1b[31m%s\x1b[0m\n", ec);
+    return 1;
+  }
+  if (pa.Argv().empty()) {
+    usage();
+    return 1;
+  }
+  int result = 0;
+  std::vector<checksum_entry> entries;
+  for (const auto a : pa.Argv()) {
+    if (check ? !checksum_parse(a, entries, ec) : !checksum_expand(a, entries, ec)) {
+      bela::FPrintF(stderr, L"File: '%s' error: \x1b[31m%s\x1b[0m\n", a, ec);
+      result = 1;
+    }
+  }
+  size_t mismatched = 0;
+  checksum_run(entries, method, jobs, [&](const checksum_entry &e) {
+    if (!e.hashed) {
+      bela::FPrintF(stderr, L"File: '%s' cannot calculate %s checksum: \x1b[31m%s\x1b[0m\n", e.name, name, e.ec);
+      result = 1;
+      return;
+    }
+    if (!check) {
+      bela::FPrintF(stdout, L"%s %s\n", e.digest, e.name);
+      return;
+    }
+    if (bela::EqualsIgnoreCase(e.digest, e.expected)) {
+      bela::FPrintF(stdout, L"%s: \x1b[32mOK\x1b[0m\n", e.name);
+      return;
+    }
+    bela::FPrintF(stdout, L"%s: \x1b[31mFAILED\x1b[0m\n", e.name);
+    mismatched++;
+    result = 1;
+  });
+  if (mismatched != 0) {
+    bela::FPrintF(stderr, L"\x1b[33mWARNING: %d of %d computed checksums did NOT match\x1b[0m\n", mismatched,
+                  entries.size());
+  }
+  return result;
+}
+} // namespace baulk
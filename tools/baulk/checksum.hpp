@@ -0,0 +1,15 @@
+//
+#ifndef BAULK_CHECKSUM_HPP
+#define BAULK_CHECKSUM_HPP
+#include <bela/base.hpp>
+#include <baulk/hash.hpp>
+#include <vector>
+
+namespace baulk {
+// checksum_command implements the sha256sum and b3sum commands: files are hashed on up to --jobs threads and printed
+// in input order, directories are walked recursively, and -c verifies the files listed in checksum files
+int checksum_command(const std::vector<std::wstring_view> &argv, hash::hash_t method, std::wstring_view name,
+                     void (*usage)());
+} // namespace baulk
+
+#endif
@@ -1,17 +1,20 @@
 //
 #include <bela/terminal.hpp>
-#include <baulk/hash.hpp>
-#include <baulk/fs.hpp>
+#include "checksum.hpp"
 #include "commands.hpp"
 
 namespace baulk::commands {
 
 void usage_b3sum() {
-  bela::FPrintF(stderr, LR"(Usage: baulk b3sum [file] ...
-Print BLAKE3 (256-bit) checksums.
+  bela::FPrintF(stderr, LR"(Usage: baulk b3sum [option] [file|directory] ...
+Print or check BLAKE3 (256-bit) checksums, directories are hashed recursively.
+  -c|--check       Read BLAKE3 sums from the files and check them
+  -j|--jobs        Number of files hashed at the same time. default: number of processors
 
 Example:
   baulk b3sum baulk.zip
+  baulk b3sum dist > dist.b3sum
+  baulk b3sum -c dist.b3sum
 
 )");
 }
@@ -21,15 +24,6 @@ int cmd_b3sum(const argv_t &argv) {
     usage_b3sum();
     return 1;
   }
-  bela::error_code ec;
-  for (const auto a : argv) {
-    auto hv = baulk::hash::FileHash(a, baulk::hash::hash_t::BLAKE3, ec);
-    if (!hv) {
-      bela::FPrintF(stderr, L"File: %s cannot calculate blake3 checksum: \x1b[31m%s\x1b[0m\n", a, ec);
-      continue;
-    }
-    bela::FPrintF(stdout, L"%s %s\n", *hv, baulk::fs::FileName(a));
-  }
-  return 0;
+  return baulk::checksum_command(argv, baulk::hash::hash_t::BLAKE3, L"blake3", usage_b3sum);
 }
-} // namespace baulk::commands
\ No newline at end of file
+} // namespace baulk::commands
@@ -21,6 +21,7 @@ Usage: baulk [option] <command> [<args>]
   -T|--trace       Turn on trace mode. track baulk execution details.
   --https-proxy    Use this proxy. Equivalent to setting the environment variable 'HTTPS_PROXY'
   --force-delete   When uninstalling the package, forcefully delete the related directories
+  --paranoid       Always rehash cached downloads, even when they are unchanged since they were last verified
 
 Command:
   version          Show version number and quit
@@ -33,8 +34,8 @@ Command:
   upgrade          Upgrade all upgradeable packages
   freeze           Freeze specific package
   unfreeze         UnFreeze specific package
-  b3sum            Calculate the BLAKE3 checksum of a file
-  sha256sum        Calculate the SHA256 checksum of a file
+  b3sum            Calculate or check the BLAKE3 checksums of files
+  sha256sum        Calculate or check the SHA256 checksums of files
   cleancache       Cleanup download cache
   bucket           Add, delete or list buckets
   untar            Extract files in a tar archive. support: tar.xz tar.bz2 tar.gz tar.zstd
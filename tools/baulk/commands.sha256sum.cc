@@ -1,16 +1,19 @@
 //
 #include <bela/terminal.hpp>
-#include <baulk/hash.hpp>
-#include <baulk/fs.hpp>
+#include "checksum.hpp"
 #include "commands.hpp"
 
 namespace baulk::commands {
 void usage_sha256sum() {
-  bela::FPrintF(stderr, LR"(Usage: baulk sha256sum [file] ...
-Print SHA256 (256-bit) checksums.
+  bela::FPrintF(stderr, LR"(Usage: baulk sha256sum [option] [file|directory] ...
+Print or check SHA256 (256-bit) checksums, directories are hashed recursively.
+  -c|--check       Read SHA256 sums from the files and check them
+  -j|--jobs        Number of files hashed at the same time. default: number of processors
 
 Example:
   baulk sha256sum baulk.zip
+  baulk sha256sum dist > dist.sha256sum
+  baulk sha256sum -c dist.sha256sum
 
 )");
 }
@@ -19,15 +22,6 @@ int cmd_sha256sum(const argv_t &argv) {
     usage_sha256sum();
     return 1;
   }
-  bela::error_code ec;
-  for (const auto a : argv) {
-    auto hv = baulk::hash::FileHash(a, baulk::hash::hash_t::SHA256, ec);
-    if (!hv) {
-      bela::FPrintF(stderr, L"File: '%s' cannot calculate sha256 checksum: \x1b[31m%s\x1b[0m\n", a, ec);
-      continue;
-    }
-    bela::FPrintF(stdout, L"%s %s\n", *hv, baulk::fs::FileName(a));
-  }
-  return 0;
+  return baulk::checksum_command(argv, baulk::hash::hash_t::SHA256, L"sha256", usage_sha256sum);
 }
-} // namespace baulk::commands
\ No newline at end of file
+} // namespace baulk::commands
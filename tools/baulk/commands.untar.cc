@@ -1,25 +1,64 @@
 //
+#include <baulk/argv.hpp>
 #include "baulk.hpp"
 #include "commands.hpp"
 #include "extractor.hpp"
 
 namespace baulk::commands {
 void usage_untar() {
-  bela::FPrintF(stderr, LR"(Usage: baulk untar [tarfile] [destination]
+  bela::FPrintF(stderr, LR"(Usage: baulk untar [option] [tarfile] [destination] [member]...
 Extract files in a tar archive. support: tar.xz tar.bz2 tar.gz tar.zstd
+When members are given, only they and the entries below them are extracted.
+
+  -l|--list        List the entries of the archive (size and name) instead of extracting it
 
 Example:
   baulk untar curl-7.80.0.tar.gz
   baulk untar curl-7.80.0.tar.gz curl-dest
+  baulk untar curl-7.80.0.tar.gz curl-dest curl-7.80.0/include
+  baulk untar --list curl-7.80.0.tar.gz
 
 )");
 }
 
 int cmd_untar(const argv_t &argv) {
-  if (argv.empty()) {
+  baulk::cli::ParseArgv pa(argv);
+  pa.Add(L"list", baulk::cli::no_argument, L'l');
+  bool list{false};
+  bela::error_code ec;
+  auto ret = pa.Execute(
+      [&](int val, const wchar_t *, const wchar_t *) {
+        if (val == L'l') {
+          list = true;
+        }
+        return true;
+      },
+      ec);
+  if (!ret) {
+    bela::FPrintF(stderr, L"baulk: parse argv error \x1b[31m%s\x1b[0m\n", ec);
+    return 1;
+  }
+  const auto &args = pa.Argv();
+  if (args.empty()) {
     usage_untar();
     return 1;
   }
-  return baulk::extract_command_unchecked(argv, baulk::extract_tar);
+  std::filesystem::path archive_file(args[0]);
+  if (list) {
+    if (!baulk::list_tar(archive_file, ec)) {
+      bela::FPrintF(stderr, L"baulk untar: %v error: %v\n", archive_file.filename(), ec);
+      return 1;
+    }
+    return 0;
+  }
+  if (args.size() > 2) {
+    std::vector<std::wstring_view> members(args.begin() + 2, args.end());
+    if (!baulk::extract_tar_members(archive_file, args[1], members, ec)) {
+      bela::FPrintF(stderr, L"baulk untar: %v error: %v\n", archive_file.filename(), ec);
+      return 1;
+    }
+    return 0;
+  }
+  return baulk::extract_command_unchecked(args, baulk::extract_tar);
 }
 } // namespace baulk::commands
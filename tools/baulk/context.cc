@@ -4,6 +4,7 @@
 #include <baulk/vfs.hpp>
 #include <baulk/json_utils.hpp>
 #include <baulk/fs.hpp>
+#include <baulk/net.hpp>
 #include "baulk.hpp"
 
 namespace baulk {
@@ -85,6 +86,9 @@ bool Context::initializeInternal(const std::wstring &profile_, bela::error_code
 
   auto jv = jo->view();
   localeName = jv.fetch("locale", localeName);
+  // seconds to trust the measured mirror connection times, 0 probes the mirrors of every package
+  baulk::net::SetMirrorCache(bela::StringCat(vfs::AppBuckets(), L"\\mirrors.json"),
+                             std::chrono::seconds(jv.fetch_as_integer("mirror_ttl", 600)));
   auto svs = jv.subviews("bucket");
   for (auto sv : svs) {
     buckets.emplace_back(
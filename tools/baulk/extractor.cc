@@ -5,6 +5,8 @@
 #include <bela/process.hpp>
 #include <bela/simulator.hpp>
 #include <bela/terminal.hpp>
+#include <bela/match.hpp>
+#include <algorithm>
 #include <ShObjIdl.h>
 #include <ShlObj_core.h>
 #include <baulk/vfs.hpp>
@@ -47,6 +49,18 @@ inline void progress_show(bela::terminal::terminal_size &termsz, const std::wstr
   bela::FPrintF(stderr, L"\x1b[2K\r\x1b[33mx ...\\%s\x1b[0m", bela::BaseName(filename));
 }
 
+// enable_mapping maps a tar or single file archive when opts asks for it, an archive that cannot be mapped is read
+// with ReadFile instead
+inline void enable_mapping(baulk::archive::tar::FileReader &fr, const ExtractorOptions &opts,
+                           const std::filesystem::path &archive_file) {
+  if (!opts.memory_mapped) {
+    return;
+  }
+  if (bela::error_code ec; !fr.EnableMapping(ec)) {
+    DbgPrint(L"map %v error: %v, read it instead", archive_file.filename(), ec);
+  }
+}
+
 class ZipExtractor final : public Extractor {
 public:
   ZipExtractor(bela::io::FD &&fd_, const std::filesystem::path &archive_file_,
@@ -54,7 +68,13 @@ public:
       : fd(std::move(fd_)), extractor(opts), archive_file(archive_file_), destination(destination_) {}
   bool Extract(bela::error_code &ec);
   bool Initialize(int64_t size, int64_t offset, bela::error_code &ec) {
-    return extractor.OpenReader(fd, destination, size, offset, ec);
+    if (!extractor.OpenReader(fd, destination, size, offset, ec)) {
+      return false;
+    }
+    if (const auto &me = extractor.MappingError(); me) {
+      DbgPrint(L"map %v error: %v, read it instead", archive_file.filename(), me);
+    }
+    return true;
   }
 
 private:
@@ -85,6 +105,80 @@ bool ZipExtractor::Extract(bela::error_code &ec) {
   return true;
 }
 
+// member_path folds an archive path for comparisons: '/' separators, no leading './' and no trailing separator
+inline std::wstring member_path(std::wstring_view name) {
+  std::wstring p(name);
+  std::replace(p.begin(), p.end(), L'\\', L'/');
+  while (p.starts_with(L"./")) {
+    p.erase(0, 2);
+  }
+  while (!p.empty() && p.back() == L'/') {
+    p.pop_back();
+  }
+  return p;
+}
+
+// member_selected reports whether name is one of members or lies below one of them
+inline bool member_selected(std::wstring_view name, const std::vector<std::wstring> &members) {
+  auto p = member_path(name);
+  for (const auto &m : members) {
+    if (bela::StartsWithIgnoreCase(p, m) && (p.size() == m.size() || p[m.size()] == L'/')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// tar downloads in the cache keep a table of contents next to them (<archive>.toc): every entry with its data offset
+// and, for .tar.gz, the gzip checkpoints. The first extraction or listing records it, later listings read it and
+// extractions of a few members seek with it. The extract handlers do not know the package hash and hashing the archive
+// would cost the pass the toc saves, so the key is the archive size and modification time
+class TocSidecar {
+public:
+  // Open returns false when archive_file is not a cached download, a sidecar that does not match is recorded again
+  bool Open(const std::filesystem::path &archive_file, bela::io::FD &fd) {
+    std::error_code e;
+    if (!std::filesystem::equivalent(archive_file.parent_path(), baulk::vfs::AppTemp(), e)) {
+      return false;
+    }
+    bela::error_code ec;
+    auto size = fd.Size(ec);
+    if (size == bela::SizeUnInitialized) {
+      return false;
+    }
+    auto modified = std::filesystem::last_write_time(archive_file, e);
+    if (e) {
+      return false;
+    }
+    key = bela::encode_into<wchar_t, char>(bela::StringCat(size, L"-", modified.time_since_epoch().count()));
+    file = archive_file;
+    file += L".toc";
+    if (std::filesystem::exists(file, e)) {
+      if (loaded = toc.Load(file, key, ec); !loaded) {
+        DbgPrint(L"load toc %v error: %v, record it again", file.filename(), ec);
+        toc = baulk::archive::tar::Toc();
+      }
+    }
+    return true;
+  }
+  bool Loaded() const { return loaded; }
+  baulk::archive::tar::Toc &Get() { return toc; }
+  // Save keeps a toc recorded over every header
+  void Save() {
+    // every entry was read, later reads only seek with the checkpoints
+    toc.Index().MarkComplete();
+    if (bela::error_code ec; !toc.Save(file, key, ec)) {
+      DbgPrint(L"save toc %v error: %v", file.filename(), ec);
+    }
+  }
+
+private:
+  std::filesystem::path file;
+  std::string key;
+  baulk::archive::tar::Toc toc;
+  bool loaded{false};
+};
+
 // tar or gz and other archive
 class UniversalExtractor final : public Extractor {
 public:
@@ -94,39 +188,54 @@ public:
       : fd(std::move(fd_)), archive_file(archive_file_), destination(destination_), opts(opts_), offset(offset_),
         afmt(afmt_) {}
   bool Extract(bela::error_code &ec);
+  // Select extracts only the tar entries named by members and the entries below them
+  void Select(const std::vector<std::wstring_view> &members_) {
+    for (auto m : members_) {
+      members.emplace_back(member_path(m));
+    }
+  }
 
 private:
   bool single_file_extract(bela::error_code &ec);
   bool tar_extract(bela::error_code &ec);
-  bool tar_extract(baulk::archive::tar::FileReader &fr, baulk::archive::tar::ExtractReader *reader,
+  // replay extracts the entries listed in toc, otherwise the headers are parsed and recorded into toc when it is set
+  bool tar_extract(baulk::archive::tar::ExtractReader *reader, baulk::archive::tar::Toc *toc, bool replay,
                    bela::error_code &ec);
   bela::io::FD fd;
   std::filesystem::path archive_file;
   std::filesystem::path destination;
+  std::vector<std::wstring> members;
   ExtractorOptions opts;
   int64_t offset{0};
   baulk::archive::file_format_t afmt;
 };
 
-bool UniversalExtractor::tar_extract(baulk::archive::tar::FileReader &fr, baulk::archive::tar::ExtractReader *reader,
-                                     bela::error_code &ec) {
-  auto size = fd.Size(ec);
-  if (size == bela::SizeUnInitialized) {
-    return false;
-  }
+bool UniversalExtractor::tar_extract(baulk::archive::tar::ExtractReader *reader, baulk::archive::tar::Toc *toc,
+                                     bool replay, bela::error_code &ec) {
   baulk::archive::tar::Extractor extractor(reader, opts);
   if (!extractor.InitializeExtractor(destination, ec)) {
     return false;
   }
+  if (!members.empty()) {
+    extractor.Select([&](const baulk::archive::tar::Header &hdr, const std::wstring &relative_name) -> bool {
+      return member_selected(relative_name, members);
+    });
+  }
   bela::terminal::terminal_size termsz;
   terminal_size_initialize(termsz);
-  if (!extractor.Extract(
-          [&](const baulk::archive::tar::Header &hdr, const std::wstring &relative_name) -> bool {
-            progress_show(termsz, relative_name);
-            return true;
-          },
-          nullptr, ec)) {
-    return false;
+  auto filter = [&](const baulk::archive::tar::Header &hdr, const std::wstring &relative_name) -> bool {
+    progress_show(termsz, relative_name);
+    return true;
+  };
+  if (replay) {
+    if (!extractor.ExtractToc(*toc, filter, nullptr, ec)) {
+      return false;
+    }
+  } else {
+    extractor.RecordToc(toc);
+    if (!extractor.Extract(filter, nullptr, ec)) {
+      return false;
+    }
   }
   if (!baulk::IsDebugMode && !baulk::IsQuietMode) {
     bela::FPrintF(stderr, L"\n");
@@ -136,13 +245,26 @@ bool UniversalExtractor::tar_extract(baulk::archive::tar::FileReader &fr, baulk:
 
 bool UniversalExtractor::tar_extract(bela::error_code &ec) {
   baulk::archive::tar::FileReader fr(fd.NativeFD());
-  if (auto wr = baulk::archive::tar::MakeReader(fr, offset, afmt, ec); wr) {
-    return tar_extract(fr, wr.get(), ec);
+  enable_mapping(fr, opts, archive_file);
+  TocSidecar sidecar;
+  auto cached = sidecar.Open(archive_file, fd);
+  // a full extraction has nothing to seek, a loaded toc is only replayed for members
+  auto recording = cached && !sidecar.Loaded();
+  auto replay = sidecar.Loaded() && !members.empty();
+  auto &toc = sidecar.Get();
+  auto wr = baulk::archive::tar::MakeReader(fr, offset, afmt, opts.decoder,
+                                            recording || replay ? &toc.Index() : nullptr, ec);
+  if (!wr && ec != baulk::archive::tar::ErrNoFilter) {
+    return false;
   }
-  if (ec != baulk::archive::tar::ErrNoFilter) {
+  auto reader = wr ? wr.get() : static_cast<baulk::archive::tar::ExtractReader *>(&fr);
+  if (!tar_extract(reader, recording || replay ? &toc : nullptr, replay, ec)) {
     return false;
   }
-  return tar_extract(fr, &fr, ec);
+  if (recording) {
+    sidecar.Save();
+  }
+  return true;
 }
 
 bool UniversalExtractor::single_file_extract(bela::error_code &ec) {
@@ -151,7 +273,8 @@ bool UniversalExtractor::single_file_extract(bela::error_code &ec) {
     return false;
   }
   baulk::archive::tar::FileReader fr(fd.NativeFD());
-  auto wr = baulk::archive::tar::MakeReader(fr, offset, afmt, ec);
+  enable_mapping(fr, opts, archive_file);
+  auto wr = baulk::archive::tar::MakeReader(fr, offset, afmt, opts.decoder, ec);
   if (!wr) {
     return false;
   }
@@ -197,6 +320,10 @@ bool UniversalExtractor::Extract(bela::error_code &ec) {
   if (ec != baulk::archive::ErrAnotherWay) {
     return false;
   }
+  if (!members.empty()) {
+    ec = bela::make_error_code(bela::ErrGeneral, L"'", archive_file.filename(), L"' is not a tar archive");
+    return false;
+  }
   return single_file_extract(ec);
 }
 
@@ -403,6 +530,11 @@ bool extract_msi(const std::filesystem::path &archive_file, const std::filesyste
   return true;
 }
 
+// extraction commands use every processor thread: zip entries are decoded in parallel (each with a serial xz decoder),
+// tar streams are pipelined and their xz stream decoded on several threads
+constexpr baulk::archive::ExtractorOptions concurrent_options{
+    .threads = 0, .memory_mapped = true, .decoder = {.threads = 0}};
+
 bool extract_zip(const std::filesystem::path &archive_file, const std::filesystem::path &destination,
                  bela::error_code &ec) {
   baulk::archive::file_format_t afmt{};
@@ -417,7 +549,7 @@ bool extract_zip(const std::filesystem::path &archive_file, const std::filesyste
                   baulk::archive::FormatToMIME(afmt));
     return false;
   }
-  ZipExtractor extractor(std::move(*fd), archive_file, destination, baulk::archive::ExtractorOptions{});
+  ZipExtractor extractor(std::move(*fd), archive_file, destination, concurrent_options);
   if (!extractor.Initialize(bela::SizeUnInitialized, baseOffset, ec)) {
     return false;
   }
@@ -453,14 +585,76 @@ bool extract_tar(const std::filesystem::path &archive_file, const std::filesyste
     bela::FPrintF(stderr, L"baulk open archive %s error: %s\n", archive_file.filename(), ec);
     return false;
   }
-  UniversalExtractor extractor(std::move(*fd), archive_file, destination, baulk::archive::ExtractorOptions{},
-                               baseOffset, afmt);
+  UniversalExtractor extractor(std::move(*fd), archive_file, destination, concurrent_options, baseOffset, afmt);
   if (!extractor.Extract(ec)) {
     return false;
   }
   return baulk::fs::MakeFlattened(destination, ec);
 }
 
+bool extract_tar_members(const std::filesystem::path &archive_file, const std::filesystem::path &destination,
+                         const std::vector<std::wstring_view> &members, bela::error_code &ec) {
+  baulk::archive::file_format_t afmt{};
+  int64_t baseOffset = 0;
+  auto fd = archive::OpenFile(archive_file.native(), baseOffset, afmt, ec);
+  if (!fd) {
+    bela::FPrintF(stderr, L"baulk open archive %s error: %s\n", archive_file.filename(), ec);
+    return false;
+  }
+  UniversalExtractor extractor(std::move(*fd), archive_file, destination, concurrent_options, baseOffset, afmt);
+  extractor.Select(members);
+  return extractor.Extract(ec);
+}
+
+bool list_tar(const std::filesystem::path &archive_file, bela::error_code &ec) {
+  baulk::archive::file_format_t afmt{};
+  int64_t baseOffset = 0;
+  auto fd = archive::OpenFile(archive_file.native(), baseOffset, afmt, ec);
+  if (!fd) {
+    bela::FPrintF(stderr, L"baulk open archive %s error: %s\n", archive_file.filename(), ec);
+    return false;
+  }
+  TocSidecar sidecar;
+  auto cached = sidecar.Open(archive_file, *fd);
+  auto &toc = sidecar.Get();
+  if (!sidecar.Loaded()) {
+    // no toc yet: read every header once and keep the toc of a cached download
+    baulk::archive::tar::FileReader fr(fd->NativeFD());
+    auto wr = baulk::archive::tar::MakeReader(fr, baseOffset, afmt, concurrent_options.decoder,
+                                              cached ? &toc.Index() : nullptr, ec);
+    if (!wr && ec != baulk::archive::tar::ErrNoFilter) {
+      return false;
+    }
+    baulk::archive::tar::Reader tr(wr ? wr.get() : static_cast<baulk::archive::tar::ExtractReader *>(&fr));
+    for (;;) {
+      auto fh = tr.Next(ec);
+      if (!fh) {
+        break;
+      }
+      toc.Add(*fh, tr.Position());
+    }
+    if (tr.Index() == 0 && ec == baulk::archive::tar::ErrNotTarFile) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"'", archive_file.filename(), L"' is not a tar archive");
+      return false;
+    }
+    if (ec && ec != bela::ErrEnded) {
+      return false;
+    }
+    ec.clear();
+    if (cached) {
+      sidecar.Save();
+    }
+  }
+  for (const auto &e : toc.Entries()) {
+    if (e.typeflag == baulk::archive::tar::TypeSymlink) {
+      bela::FPrintF(stdout, L"%12d %s -> %s\n", e.size, e.name, e.linkname);
+      continue;
+    }
+    bela::FPrintF(stdout, L"%12d %s\n", e.size, e.name);
+  }
+  return true;
+}
+
 bool extract_auto(const std::filesystem::path &archive_file, const std::filesystem::path &destination,
                   bela::error_code &ec) {
   auto extractor = MakeExtractor(archive_file, destination, baulk::archive::ExtractorOptions{}, ec);
@@ -506,4 +700,177 @@ std::optional<std::filesystem::path> make_unqiue_extracted_destination(const std
   return std::nullopt;
 }
 
+DownloadExtractor::DownloadExtractor(const std::filesystem::path &destination_, size_t budget_)
+    : destination(destination_), budget(budget_) {
+  worker = std::thread([this] { run(); });
+}
+
+DownloadExtractor::~DownloadExtractor() {
+  bela::error_code ec;
+  Wait(ec);
+}
+
+void DownloadExtractor::Write(const void *data, size_t len) {
+  received += static_cast<int64_t>(len);
+  std::unique_lock<std::mutex> lock(mtx);
+  // a single oversized chunk is always admitted
+  cv.wait(lock, [&] { return finished || queued == 0 || queued + len <= budget; });
+  if (finished) {
+    return;
+  }
+  auto p = static_cast<const uint8_t *>(data);
+  chunks.emplace_back(p, p + len);
+  queued += len;
+  cv.notify_all();
+}
+
+bool DownloadExtractor::Wait(bela::error_code &ec) {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    closed = true;
+  }
+  cv.notify_all();
+  if (worker.joinable()) {
+    worker.join();
+  }
+  if (!result) {
+    ec = extractEc;
+    return false;
+  }
+  return true;
+}
+
+bool DownloadExtractor::Verify(const std::filesystem::path &archive_file, bela::error_code &ec) const {
+  if (!zipEntries) {
+    return true;
+  }
+  return baulk::archive::zip::MatchCentralDirectory(archive_file, destination, *zipEntries, ec);
+}
+
+bool DownloadExtractor::acquire() {
+  if (pos < current.size()) {
+    return true;
+  }
+  std::unique_lock<std::mutex> lock(mtx);
+  cv.wait(lock, [this] { return closed || !chunks.empty(); });
+  if (chunks.empty()) {
+    return false;
+  }
+  current = std::move(chunks.front());
+  chunks.pop_front();
+  queued -= current.size();
+  pos = 0;
+  cv.notify_all();
+  return true;
+}
+
+bela::ssize_t DownloadExtractor::Read(void *buffer, size_t len, bela::error_code &ec) {
+  if (!acquire()) {
+    return 0;
+  }
+  auto minsize = (std::min)(len, current.size() - pos);
+  memcpy(buffer, current.data() + pos, minsize);
+  pos += minsize;
+  return static_cast<bela::ssize_t>(minsize);
+}
+
+bool DownloadExtractor::Discard(int64_t len, bela::error_code &ec) {
+  while (len > 0) {
+    if (!acquire()) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"unexpected end of the download");
+      return false;
+    }
+    auto minsize = (std::min)(static_cast<size_t>(len), current.size() - pos);
+    pos += minsize;
+    len -= minsize;
+  }
+  return true;
+}
+
+bool DownloadExtractor::WriteTo(const baulk::archive::tar::Writer &w, int64_t filesize, int64_t &extracted,
+                                bela::error_code &ec) {
+  while (filesize > 0) {
+    if (!acquire()) {
+      ec = bela::make_error_code(bela::ErrGeneral, L"unexpected end of the download");
+      return false;
+    }
+    auto minsize = (std::min)(static_cast<size_t>(filesize), current.size() - pos);
+    auto p = current.data() + pos;
+    pos += minsize;
+    filesize -= minsize;
+    extracted += minsize;
+    if (!w(p, minsize, ec)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void DownloadExtractor::run() {
+  bela::error_code ec;
+  auto ok = extract(ec);
+  std::lock_guard<std::mutex> lock(mtx);
+  finished = true;
+  result = ok;
+  extractEc = std::move(ec);
+  // unblock the downloader, the rest of the input is no longer read
+  chunks.clear();
+  queued = 0;
+  cv.notify_all();
+}
+
+bool DownloadExtractor::tar_extract(baulk::archive::tar::ExtractReader *r, bela::error_code &ec) {
+  baulk::archive::tar::Extractor extractor(r, concurrent_options);
+  return extractor.InitializeExtractor(destination, ec) && extractor.Extract(nullptr, nullptr, ec);
+}
+
+bool DownloadExtractor::extract(bela::error_code &ec) {
+  uint8_t magic[1024];
+  size_t n = 0;
+  while (n < sizeof(magic)) {
+    auto nbytes = Read(magic + n, sizeof(magic) - n, ec);
+    if (nbytes <= 0) {
+      break;
+    }
+    n += static_cast<size_t>(nbytes);
+  }
+  // put the leading bytes back in front of the unread part of the current chunk
+  std::vector<uint8_t> head(magic, magic + n);
+  head.insert(head.end(), current.begin() + pos, current.end());
+  current = std::move(head);
+  pos = 0;
+  auto afmt = baulk::archive::AnalyzeFormat({magic, n});
+  DbgPrint(L"extract download: %v format: %v", destination.filename(), bela::integral_cast(afmt));
+  switch (afmt) {
+  case baulk::archive::file_format_t::zip: {
+    baulk::archive::zip::StreamExtractor extractor(this, concurrent_options);
+    if (!extractor.InitializeExtractor(destination, ec) || !extractor.Extract(nullptr, nullptr, ec)) {
+      return false;
+    }
+    zipEntries = std::move(extractor.Entries());
+    return true;
+  }
+  case baulk::archive::file_format_t::tar:
+    return tar_extract(this, ec);
+  case baulk::archive::file_format_t::xz:
+    [[fallthrough]];
+  case baulk::archive::file_format_t::zstd:
+    [[fallthrough]];
+  case baulk::archive::file_format_t::gz:
+    [[fallthrough]];
+  case baulk::archive::file_format_t::bz2:
+    [[fallthrough]];
+  case baulk::archive::file_format_t::brotli:
+    if (auto r = baulk::archive::tar::MakeReader(this, afmt, concurrent_options.decoder, ec); r) {
+      return tar_extract(r.get(), ec);
+    }
+    return false;
+  default:
+    break;
+  }
+  ec = bela::make_error_code(baulk::archive::ErrAnotherWay, L"format '", baulk::archive::FormatToMIME(afmt),
+                             L"' cannot be extracted while downloading");
+  return false;
+}
+
 } // namespace baulk
\ No newline at end of file
@@ -6,6 +6,12 @@
 #include <bela/io.hpp>
 #include <bela/terminal.hpp>
 #include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <optional>
 #include <baulk/archive/extractor.hpp>
 
 namespace baulk {
@@ -29,6 +35,12 @@ bool extract_7z(const std::filesystem::path &archive_file, const std::filesystem
                 bela::error_code &ec);
 bool extract_tar(const std::filesystem::path &archive_file, const std::filesystem::path &destination,
                  bela::error_code &ec);
+// extract_tar_members extracts the named entries of a tar archive and everything below them, a cached archive with a
+// table of contents only reads the data of those entries (a .tar.gz seeks to them with the gzip checkpoints)
+bool extract_tar_members(const std::filesystem::path &archive_file, const std::filesystem::path &destination,
+                         const std::vector<std::wstring_view> &members, bela::error_code &ec);
+// list_tar prints the entries of a tar archive, a cached archive with a table of contents is listed without reading it
+bool list_tar(const std::filesystem::path &archive_file, bela::error_code &ec);
 bool extract_auto(const std::filesystem::path &archive_file, const std::filesystem::path &destination,
                   bela::error_code &ec);
 
@@ -38,6 +50,52 @@ bool extract_command_auto(const std::filesystem::path &archive_file, const std::
 std::optional<std::filesystem::path> make_unqiue_extracted_destination(const std::filesystem::path &archive_file,
                                                                        std::filesystem::path &strict_folder);
 
+// DownloadExtractor extracts a tar.* or zip archive while it is downloaded: Write queues the received bytes and the
+// extraction thread reads them back in order. The queue is bounded so a slow disk throttles the download instead of
+// buffering the whole archive. Formats that need seeking make Wait fail with ErrAnotherWay
+class DownloadExtractor final : public baulk::archive::tar::ExtractReader, public baulk::archive::zip::StreamSource {
+public:
+  DownloadExtractor(const std::filesystem::path &destination_, size_t budget_ = 32 * 1024 * 1024);
+  DownloadExtractor(const DownloadExtractor &) = delete;
+  DownloadExtractor &operator=(const DownloadExtractor &) = delete;
+  ~DownloadExtractor();
+  // Write is called by the downloader, bytes arriving after the extraction stopped are dropped
+  void Write(const void *data, size_t len);
+  // Wait marks the end of the input and waits for the extraction thread
+  bool Wait(bela::error_code &ec);
+  // Received returns the number of bytes passed to Write
+  int64_t Received() const { return received; }
+  // Verify compares a streamed zip with the central directory of the complete download archive_file, the staging
+  // folder must be expanded from archive_file again when it fails. Tar streams need no check
+  bool Verify(const std::filesystem::path &archive_file, bela::error_code &ec) const;
+  bela::ssize_t Read(void *buffer, size_t len, bela::error_code &ec) override;
+  bool Discard(int64_t len, bela::error_code &ec) override;
+  bool WriteTo(const baulk::archive::tar::Writer &w, int64_t filesize, int64_t &extracted,
+               bela::error_code &ec) override;
+
+private:
+  void run();
+  bool extract(bela::error_code &ec);
+  bool tar_extract(baulk::archive::tar::ExtractReader *r, bela::error_code &ec);
+  // acquire makes sure the current chunk has unread data, it returns false at the end of the input
+  bool acquire();
+  std::filesystem::path destination;
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::deque<std::vector<uint8_t>> chunks;
+  std::vector<uint8_t> current;
+  size_t pos{0};
+  size_t budget{0};
+  size_t queued{0};
+  int64_t received{0};
+  bool closed{false};   // the download ended
+  bool finished{false}; // the extraction thread stopped reading
+  bool result{false};
+  bela::error_code extractEc;
+  std::optional<baulk::archive::zip::StreamedEntries> zipEntries;
+  std::thread worker;
+};
+
 using extract_method_t = decltype(&extract_exe);
 
 inline auto resolve_extract_handle(const std::wstring_view extension) -> extract_method_t {
@@ -5,6 +5,7 @@
 #include <bela/simulator.hpp>
 #include <bela/datetime.hpp>
 #include <bela/semver.hpp>
+#include <bela/match.hpp>
 #include <baulk/fs.hpp>
 #include <baulk/vfs.hpp>
 #include <baulk/json_utils.hpp>
@@ -85,6 +86,125 @@ bool PackageForceDelete(std::wstring_view pkgName, bela::error_code &ec) {
   return true;
 }
 
+// file_identity changes whenever a download is rewritten, replaced or touched
+struct file_identity {
+  uint64_t size{0};
+  uint64_t modified{0};
+  std::string id;
+};
+
+std::optional<file_identity> make_file_identity(const std::filesystem::path &file) {
+  HANDLE FileHandle = CreateFileW(file.c_str(), FILE_READ_ATTRIBUTES,
+                                  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (FileHandle == INVALID_HANDLE_VALUE) {
+    return std::nullopt;
+  }
+  auto closer = bela::finally([&] { CloseHandle(FileHandle); });
+  BY_HANDLE_FILE_INFORMATION fi;
+  if (GetFileInformationByHandle(FileHandle, &fi) != TRUE) {
+    return std::nullopt;
+  }
+  return std::make_optional(file_identity{
+      .size = (static_cast<uint64_t>(fi.nFileSizeHigh) << 32) | fi.nFileSizeLow,
+      .modified = (static_cast<uint64_t>(fi.ftLastWriteTime.dwHighDateTime) << 32) | fi.ftLastWriteTime.dwLowDateTime,
+      .id = bela::encode_into<wchar_t, char>(bela::StringCat(
+          fi.dwVolumeSerialNumber, L"-", (static_cast<uint64_t>(fi.nFileIndexHigh) << 32) | fi.nFileIndexLow)),
+  });
+}
+
+bool same_file_identity(const nlohmann::json &o, const file_identity &fi) {
+  return o.is_object() && o.value("size", uint64_t{0}) == fi.size && o.value("modified", uint64_t{0}) == fi.modified &&
+         o.value("id", std::string()) == fi.id;
+}
+
+// downloads that do not stream into the extractor use several connections, a retry resumes the segments left in
+// the part file
+constexpr uint32_t download_connections = 4;
+
+// same_hash_value compares two package hash values, 'SHA256:digest' and a bare digest are the same value
+bool same_hash_value(std::wstring_view a, std::wstring_view b) {
+  auto am = hash::hash_t::SHA256;
+  auto bm = hash::hash_t::SHA256;
+  std::wstring_view av;
+  std::wstring_view bv;
+  bela::error_code ec;
+  return hash::ParseHashValue(a, am, av, ec) && hash::ParseHashValue(b, bm, bv, ec) && am == bm &&
+         bela::EqualsIgnoreCase(av, bv);
+}
+
+// verified_cache remembers the hash values already checked against the downloads, in downloads\verified.json. An
+// entry holds only while the download keeps the size, modification time and file id it had when it was verified
+class verified_cache {
+public:
+  explicit verified_cache(const std::filesystem::path &downloads) : cacheFile(downloads / L"verified.json") {
+    bela::error_code ec;
+    if (auto jo = parse_json_file(cacheFile.native(), ec); jo && jo->obj.is_object()) {
+      obj = std::move(jo->obj);
+    }
+  }
+  bool Verified(const std::filesystem::path &file, std::wstring_view hash) const {
+    auto it = obj.find(bela::encode_into<wchar_t, char>(file.filename().native()));
+    auto fi = make_file_identity(file);
+    if (it == obj.end() || !fi) {
+      return false;
+    }
+    try {
+      if (!same_file_identity(*it, *fi)) {
+        return false;
+      }
+      if (auto hashes = it->find("hashes"); hashes != it->end() && hashes->is_array()) {
+        for (const auto &h : *hashes) {
+          if (h.is_string() && same_hash_value(bela::encode_into<char, wchar_t>(h.get<std::string_view>()), hash)) {
+            return true;
+          }
+        }
+      }
+    } catch (const std::exception &) {
+    }
+    return false;
+  }
+  void Record(const std::filesystem::path &file, std::wstring_view hash) {
+    auto fi = make_file_identity(file);
+    if (!fi) {
+      return;
+    }
+    auto name = bela::encode_into<wchar_t, char>(file.filename().native());
+    try {
+      auto hashes = nlohmann::json::array();
+      if (auto it = obj.find(name); it != obj.end() && same_file_identity(*it, *fi)) {
+        hashes = it->value("hashes", nlohmann::json::array());
+      }
+      if (std::none_of(hashes.begin(), hashes.end(), [&](const nlohmann::json &h) {
+            return h.is_string() && same_hash_value(bela::encode_into<char, wchar_t>(h.get<std::string_view>()), hash);
+          })) {
+        hashes.emplace_back(bela::encode_into<wchar_t, char>(hash));
+      }
+      obj[name] = nlohmann::json{{"size", fi->size}, {"modified", fi->modified}, {"id", fi->id}, {"hashes", hashes}};
+      // downloads removed by cleancache leave their entries behind
+      auto parent = file.parent_path();
+      for (auto it = obj.begin(); it != obj.end();) {
+        std::error_code e;
+        if (!std::filesystem::exists(parent / bela::encode_into<char, wchar_t>(it.key()), e)) {
+          it = obj.erase(it);
+          continue;
+        }
+        ++it;
+      }
+      bela::error_code ec;
+      if (!bela::io::AtomicWriteText(cacheFile.native(), bela::io::as_bytes<char>(obj.dump(4)), ec)) {
+        DbgPrint(L"baulk: unable save %s error: %s", cacheFile.native(), ec);
+      }
+    } catch (const std::exception &e) {
+      DbgPrint(L"baulk: unable encode %s error: %s", cacheFile.native(), e.what());
+    }
+  }
+
+private:
+  std::filesystem::path cacheFile;
+  nlohmann::json obj = nlohmann::json::object();
+};
+
 // Package cached
 std::optional<std::filesystem::path> PackageCached(const std::filesystem::path &downloads, std::wstring_view filename,
                                                    std::wstring_view hash) {
@@ -93,11 +213,17 @@ std::optional<std::filesystem::path> PackageCached(const std::filesystem::path &
   if (!std::filesystem::exists(archive_file, e)) {
     return std::nullopt;
   }
+  verified_cache vc(downloads);
+  if (!baulk::IsParanoidMode && vc.Verified(archive_file, hash)) {
+    DbgPrint(L"baulk: %s unchanged since it was verified", filename);
+    return std::make_optional(std::move(archive_file));
+  }
   bela::error_code ec;
   if (!baulk::hash::HashEqual(archive_file, hash, ec)) {
     bela::FPrintF(stderr, L"package file %s error: %s\n", filename, ec);
     return std::nullopt;
   }
+  vc.Record(archive_file, hash);
   return std::make_optional(std::move(archive_file));
 }
 
@@ -176,6 +302,8 @@ bool expand_fallback_exe(const baulk::Package &pkg, const std::filesystem::path
   return PackageMakeLinks(pkgCopy);
 }
 
+bool PackageCommit(const baulk::Package &pkg, const std::filesystem::path &destination);
+
 bool PackageExpand(const baulk::Package &pkg, const std::filesystem::path &archive_file) {
   auto fn = baulk::resolve_extract_handle(pkg.extension);
   if (!fn) {
@@ -196,6 +324,12 @@ bool PackageExpand(const baulk::Package &pkg, const std::filesystem::path &archi
     bela::FPrintF(stderr, L"baulk extract: %v error: %v\n", archive_file.filename(), ec);
     return false;
   }
+  return PackageCommit(pkg, *destination);
+}
+
+// PackageCommit replaces the package folder with the extracted destination and rebuilds the links
+bool PackageCommit(const baulk::Package &pkg, const std::filesystem::path &destination) {
+  bela::error_code ec;
   std::filesystem::path packages(baulk::vfs::AppPackages());
   auto pkgRoot = packages / pkg.name;
   std::error_code e;
@@ -209,8 +343,8 @@ bool PackageExpand(const baulk::Package &pkg, const std::filesystem::path &archi
             return false;
           }
         }
-        if (std::filesystem::rename(*destination, pkgRoot, e); e) {
-          bela::FPrintF(stderr, L"baulk rename %s to %s error: \x1b[31m%s\x1b[0m\n", *destination, pkgRoot, ec);
+        if (std::filesystem::rename(destination, pkgRoot, e); e) {
+          bela::FPrintF(stderr, L"baulk rename %s to %s error: \x1b[31m%s\x1b[0m\n", destination, pkgRoot, ec);
           if (!oldPath.empty()) {
             std::filesystem::rename(oldPath, pkgRoot, e);
           }
@@ -249,6 +383,95 @@ void DisplayDependencies(const baulk::Package &pkg) {
                 bela::StrJoin(pkg.venv.dependencies, L"\n    "));
 }
 
+void DisplayInstalled(const baulk::Package &pkg) {
+  if (!pkg.suggest.empty()) {
+    bela::FPrintF(stderr, L"'%s' suggests installing: '\x1b[32m%s\x1b[0m'\n", pkg.name,
+                  bela::StrJoin(pkg.suggest, L"\x1b[0m' or '\x1b[32m"));
+  }
+  if (!pkg.notes.empty()) {
+    bela::FPrintF(stderr, L"'%s' notes\n-----\n%s\n", pkg.name, pkg.notes);
+  }
+  DisplayDependencies(pkg);
+}
+
+// tar.* and zip packages are extracted while they download
+inline bool expand_while_downloading_supported(const baulk::Package &pkg) {
+  return pkg.extension == L"tar" || pkg.extension == L"zip";
+}
+
+// expand_while_downloading overlaps the download with the extraction into a staging folder, the received bytes are
+// hashed on the fly and the staging folder replaces the package only when the hash matches. It returns std::nullopt
+// when the package was not installed from the stream: archive_file then holds the verified download, to be expanded
+// the usual way, or nothing when the download has to be retried
+std::optional<bool> expand_while_downloading(const baulk::Package &pkg, std::wstring_view url,
+                                             const std::filesystem::path &downloads, std::wstring_view filename,
+                                             const std::vector<hash::hash_t> &hash_methods, std::wstring_view expected,
+                                             std::optional<std::filesystem::path> &archive_file) {
+  std::filesystem::path strict_folder;
+  auto destination = baulk::make_unqiue_extracted_destination(downloads / filename, strict_folder);
+  if (!destination) {
+    return std::nullopt;
+  }
+  bela::error_code ec;
+  std::vector<std::wstring> digests;
+  bela::error_code extractEc;
+  DownloadExtractor de(*destination);
+  archive_file = baulk::net::WinGet(url,
+                                    {
+                                        .hash_value = pkg.hash,
+                                        .cwd = downloads,
+                                        .force_overwrite = true,
+                                        .hash_methods = hash_methods,
+                                        .sink = [&](const void *data, size_t len) { de.Write(data, len); },
+                                    },
+                                    digests, ec);
+  auto extracted = de.Wait(extractEc);
+  auto received = de.Received();
+  auto discard_staging = [&]() {
+    std::error_code e;
+    std::filesystem::remove_all(*destination, e);
+  };
+  if (!archive_file) {
+    discard_staging();
+    bela::FPrintF(stderr, L"baulk: download '%s' error: \x1b[31m%s\x1b[0m\n", filename, ec);
+    return std::nullopt;
+  }
+  // the digest covers resumed downloads too, the part file keeps the hasher state
+  if (!pkg.hash.empty() && !bela::EndsWithIgnoreCase(digests.front(), expected)) {
+    discard_staging();
+    bela::FPrintF(stderr, L"baulk download '%s' error: \x1b[31mchecksum mismatch expected %s actual %s\x1b[0m\n",
+                  archive_file->filename(), expected, digests.front());
+    archive_file.reset();
+    return std::nullopt;
+  }
+  if (!pkg.hash.empty()) {
+    verified_cache(downloads).Record(*archive_file, pkg.hash);
+  }
+  std::error_code e;
+  if (auto size = std::filesystem::file_size(*archive_file, e); e || static_cast<int64_t>(size) != received) {
+    // a part download was resumed, the stream only saw its tail
+    discard_staging();
+    return std::nullopt;
+  }
+  if (!extracted) {
+    discard_staging();
+    DbgPrint(L"baulk: extract '%s' while downloading: %s", filename, extractEc);
+    return std::nullopt;
+  }
+  // local headers cannot describe everything the central directory does (symlinks, code page, deleted entries)
+  if (!de.Verify(*archive_file, extractEc)) {
+    discard_staging();
+    DbgPrint(L"baulk: '%s' extracted while downloading differs from the archive: %s", filename, extractEc);
+    return std::nullopt;
+  }
+  if (!baulk::fs::MakeFlattened(*destination, ec)) {
+    discard_staging();
+    bela::FPrintF(stderr, L"baulk extract: %v error: %v\n", archive_file->filename(), ec);
+    return false;
+  }
+  return PackageCommit(pkg, *destination);
+}
+
 bool PackageInstall(const baulk::Package &pkg) {
   bela::error_code ec;
   auto pkgLocal = baulk::PackageLocalMeta(pkg.name, ec);
@@ -302,19 +525,43 @@ bool PackageInstall(const baulk::Package &pkg) {
     return false;
   }
   bela::FPrintF(stderr, L"baulk: download '\x1b[36m%s\x1b[0m' \nurl: \x1b[36m%s\x1b[0m\n", filename, url);
+  std::vector<hash::hash_t> hash_methods;
+  std::wstring_view expected;
+  if (!pkg.hash.empty()) {
+    auto method = hash::hash_t::SHA256;
+    if (!hash::ParseHashValue(pkg.hash, method, expected, ec)) {
+      bela::FPrintF(stderr, L"baulk: package '%s' hash error: \x1b[31m%s\x1b[0m\n", pkg.name, ec);
+      return false;
+    }
+    hash_methods.emplace_back(method);
+  }
   std::optional<std::filesystem::path> archive_file;
-  for (int i = 0; i < 4; i++) {
+  int i = 0;
+  if (expand_while_downloading_supported(pkg)) {
+    if (auto installed = expand_while_downloading(pkg, url, downloads, filename, hash_methods, expected, archive_file);
+        installed) {
+      if (!*installed) {
+        return false;
+      }
+      DisplayInstalled(pkg);
+      return true;
+    }
+    i++;
+  }
+  for (; i < 4 && !archive_file; i++) {
     if (i != 0) {
       bela::FPrintF(stderr, L"baulk: download '\x1b[33m%s\x1b[0m' retries: \x1b[33m%d\x1b[0m\n", filename, i);
     }
-    //  downloads, pkg.hash, true
+    std::vector<std::wstring> digests;
     if (archive_file = baulk::net::WinGet(url,
                                           {
                                               .hash_value = pkg.hash,
                                               .cwd = downloads,
                                               .force_overwrite = true,
+                                              .connections = download_connections,
+                                              .hash_methods = hash_methods,
                                           },
-                                          ec);
+                                          digests, ec);
         !archive_file) {
       bela::FPrintF(stderr, L"baulk: download '%s' error: \x1b[31m%s\x1b[0m\n", filename, ec);
       continue;
@@ -323,10 +570,13 @@ bool PackageInstall(const baulk::Package &pkg) {
     if (pkg.hash.empty()) {
       break;
     }
-    if (hash::HashEqual(*archive_file, pkg.hash, ec)) {
+    if (bela::EndsWithIgnoreCase(digests.front(), expected)) {
+      verified_cache(downloads).Record(*archive_file, pkg.hash);
       break;
     }
-    bela::FPrintF(stderr, L"baulk download '%s' error: \x1b[31m%s\x1b[0m\n", archive_file->filename(), ec);
+    bela::FPrintF(stderr, L"baulk download '%s' error: \x1b[31mchecksum mismatch expected %s actual %s\x1b[0m\n",
+                  archive_file->filename(), expected, digests.front());
+    archive_file.reset();
   }
   if (!archive_file) {
     return false;
@@ -334,14 +584,7 @@ bool PackageInstall(const baulk::Package &pkg) {
   if (!PackageExpand(pkg, *archive_file)) {
     return false;
   }
-  if (!pkg.suggest.empty()) {
-    bela::FPrintF(stderr, L"'%s' suggests installing: '\x1b[32m%s\x1b[0m'\n", pkg.name,
-                  bela::StrJoin(pkg.suggest, L"\x1b[0m' or '\x1b[32m"));
-  }
-  if (!pkg.notes.empty()) {
-    bela::FPrintF(stderr, L"'%s' notes\n-----\n%s\n", pkg.name, pkg.notes);
-  }
-  DisplayDependencies(pkg);
+  DisplayInstalled(pkg);
   return true;
 }
 } // namespace baulk::package
@@ -99,7 +99,7 @@ bool UniversalExtractor::tar_extract(ProgressBar *bar, baulk::archive::tar::File
 
 bool UniversalExtractor::tar_extract(ProgressBar *bar, bela::error_code &ec) {
   baulk::archive::tar::FileReader fr(fd.NativeFD());
-  if (auto wr = baulk::archive::tar::MakeReader(fr, offset, afmt, ec); wr) {
+  if (auto wr = baulk::archive::tar::MakeReader(fr, offset, afmt, opts.decoder, ec); wr) {
     return tar_extract(bar, fr, wr.get(), ec);
   }
   if (ec != baulk::archive::tar::ErrNoFilter) {
@@ -114,7 +114,7 @@ bool UniversalExtractor::single_file_extract(ProgressBar *bar, bela::error_code
     return false;
   }
   baulk::archive::tar::FileReader fr(fd.NativeFD());
-  auto wr = baulk::archive::tar::MakeReader(fr, offset, afmt, ec);
+  auto wr = baulk::archive::tar::MakeReader(fr, offset, afmt, opts.decoder, ec);
   if (!wr) {
     return false;
   }
@@ -1,5 +1,6 @@
 // A simple program download network resource
 #include <bela/parseargv.hpp>
+#include <bela/numbers.hpp>
 #include <filesystem>
 #include <baulk/hash.hpp>
 #include <baulk/net/client.hpp>
@@ -20,6 +21,7 @@ Usage: wind [option]... [url]...
   -K|--insecure    Allow insecure server connections when using SSL
   -O|--output      Write file to the specified path
   -A|--user-agent  Send User-Agent <name> to server
+  -j|--connections Download large files over <n> connections
   --https-proxy    Use this proxy. Equivalent to setting the environment variable 'HTTPS_PROXY'
   --no-cache       Download directly without caching
 
@@ -59,19 +61,19 @@ private:
   std::vector<std::wstring> urls;
   std::filesystem::path cwd;
   std::filesystem::path destination;
+  uint32_t connections{1};
   bool replace{false};
 };
 
-void verify_file(const std::filesystem::path &file) {
-  bela::error_code ec;
+// the digests are computed by WinGet while the file downloads
+void verify_file(const std::filesystem::path &file, const std::vector<std::wstring> &digests) {
   auto filename = file.filename();
-  auto sums = baulk::hash::HashSums(file.native(), ec);
-  if (!sums) {
-    bela::FPrintF(stderr, L"unable check %s checksum: %v\n", filename.native(), ec);
+  if (digests.size() != 2) {
+    bela::FPrintF(stderr, L"unable check %s checksum\n", filename.native());
     return;
   }
-  bela::FPrintF(stderr, L"\x1b[34mSHA256:%s %s\x1b[0m\n", sums->sha256sum, filename.native());
-  bela::FPrintF(stderr, L"\x1b[34mBLAKE3:%s %s\x1b[0m\n", sums->blake3sum, filename.native());
+  bela::FPrintF(stderr, L"\x1b[34mSHA256:%s %s\x1b[0m\n", digests[0], filename.native());
+  bela::FPrintF(stderr, L"\x1b[34mBLAKE3:%s %s\x1b[0m\n", digests[1], filename.native());
 }
 
 bool Executor::ParseArgv(int argc, wchar_t **argv) {
@@ -85,6 +87,7 @@ bool Executor::ParseArgv(int argc, wchar_t **argv) {
       .Add(L"insecure", bela::no_argument, L'K')
       .Add(L"output", bela::required_argument, L'O')
       .Add(L"user-agent", bela::required_argument, 'A')
+      .Add(L"connections", bela::required_argument, 'j')
       .Add(L"https-proxy", bela::required_argument, 1001)
       .Add(L"no-cache", bela::no_argument, 1002); // option
   bela::error_code ec;
@@ -119,6 +122,12 @@ bool Executor::ParseArgv(int argc, wchar_t **argv) {
         case 'A':
           HttpClient::DefaultClient().SetUserAgent(oa);
           break;
+        case 'j':
+          if (!bela::SimpleAtoi(oa, &connections) || connections == 0) {
+            bela::FPrintF(stderr, L"wind: invalid connections '%s'\n", oa);
+            exit(1);
+          }
+          break;
         case 1001:
           HttpClient::DefaultClient().SetProxyURL(oa);
           break;
@@ -153,19 +162,22 @@ bool Executor::ParseArgv(int argc, wchar_t **argv) {
 int Executor::single_download() {
   auto u = urls[0];
   bela::error_code ec;
+  std::vector<std::wstring> digests;
   auto file = baulk::net::WinGet(urls[0],
                                  {
                                      .hash_value = L"",
                                      .cwd = cwd,
                                      .destination = destination,
                                      .force_overwrite = replace,
+                                     .connections = connections,
+                                     .hash_methods = {baulk::hash::hash_t::SHA256, baulk::hash::hash_t::BLAKE3},
                                  },
-                                 ec);
+                                 digests, ec);
   if (!file) {
     bela::FPrintF(stderr, L"download failed: \x1b[31m%v\x1b[0m\n", ec);
     return 1;
   }
-  baulk::verify_file(*file);
+  baulk::verify_file(*file, digests);
   bela::FPrintF(stdout, L"\x1b[32m'%s' saved\x1b[0m\n", file->native());
   return 0;
 }
@@ -173,18 +185,21 @@ int Executor::multi_download() {
   size_t success = 0;
   bela::error_code ec;
   for (const auto &u : urls) {
+    std::vector<std::wstring> digests;
     auto file = baulk::net::WinGet(u,
                                    {
                                        .hash_value = L"",
                                        .cwd = cwd,
                                        .force_overwrite = replace,
+                                       .connections = connections,
+                                       .hash_methods = {baulk::hash::hash_t::SHA256, baulk::hash::hash_t::BLAKE3},
                                    },
-                                   ec);
+                                   digests, ec);
     if (!file) {
       bela::FPrintF(stderr, L"download failed: \x1b[31m%s\x1b[0m\n", ec);
       continue;
     }
-    baulk::verify_file(*file);
+    baulk::verify_file(*file, digests);
     bela::FPrintF(stdout, L"\x1b[32m'%s' saved\x1b[0m\n", *file);
   }
   return success == urls.size() ? 0 : 1;